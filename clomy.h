@@ -3,7 +3,7 @@
    A header-only universal C library that provide basic data structure.
 
    Features:
-     1. Arena
+     1. Arena & Object pool
      2. Dynamic array
      3. Hash table
      4. String & String builder
@@ -14,10 +14,20 @@
      #include "clomy.h"
 
    To add "clomy_" namespace prefix:
-     #define CLOMY_NO_SHORT_NAMES
+     #define CLOMY_NO_SHORT_NAMES 
 
    By default, CLOMY uses platform native API. To prefer using LIBC
-     #define CLOMY_PREFER_LIBC */
+     #define CLOMY_PREFER_LIBC
+
+   To share arenas between threads (needs C11 atomics and thread locals)
+     #define CLOMY_THREADS
+
+   To count arena usage for clomy_arstats and enable clomy_ardump
+     #define CLOMY_ARENA_STATS
+
+   To build the numeric array kernels for the compiler's target only,
+   instead of also for AVX2 and AVX-512 picked at load time
+     #define CLOMY_NO_DISPATCH */
 
 #ifndef CLOMY_H
 #define CLOMY_H
@@ -26,45 +36,122 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <unistd.h>
+#endif /* defined(__unix__) || defined(__APPLE__) */
+
+#if defined(CLOMY_THREADS)
+  #include <stdatomic.h>
+  #include <stddef.h>
+#endif /* defined(CLOMY_THREADS) */
+
+#if defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+#endif /* defined(__SSE2__) || defined(_M_X64) */
 
 #if defined(CLOMY_PREFER_LIBC)
-#define CLOMY_strcpy(dst, src, n) strncpy ((dst), (src), (n))
+  #define CLOMY_strcpy(dst, src, n) strncpy((dst), (src), (n))
 #else
-#if defined(_WIN32)
-#include <windows.h>
-static HANDLE CLOMY__heap = NULL;
-static inline char *
-CLOMY_strncpy_winapi (char *dst, const char *src, size_t n)
-{
-  if (n == 0)
-    return dst;
+  #if defined(_WIN32)
+    #include <windows.h>
+    static HANDLE CLOMY__heap = NULL;
+    static inline char* CLOMY_strncpy_winapi(char *dst, const char *src, size_t n) {
+      if (n == 0)
+        return dst;
 
-  size_t srclen = strlen (src);
-  size_t copylen = (srclen < n) ? srclen : n;
+      size_t srclen = strlen(src);
+      size_t copylen = (srclen < n) ? srclen : n;
 
-  memcpy (dst, src, copylen);
+      memcpy(dst, src, copylen);
 
-  if (copylen < n)
-    memset (dst + copylen, 0, n - copylen);
+      if (copylen < n)
+        memset(dst + copylen, 0, n - copylen);
 
-  return dst;
-}
-#define CLOMY_strcpy(dst, src, n) CLOMY_strncpy_winapi ((dst), (src), (n))
-#elif defined(_POSIX_VERSION)
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <unistd.h>
-#define CLOMY_strcpy(dst, src, n) strncpy ((dst), (src), (n))
-#else
-#define CLOMY_strcpy(dst, src, n) strncpy ((dst), (src), (n))
-#endif /* defined(_WIN32) */
+      return dst;
+    }
+    #define CLOMY_strcpy(dst, src, n) CLOMY_strncpy_winapi((dst), (src), (n))
+  #elif defined(_POSIX_VERSION)
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+      #define MAP_ANONYMOUS MAP_ANON
+    #endif /* !defined(MAP_ANONYMOUS) && defined(MAP_ANON) */
+    /* Chunks are mapped, otherwise they fall back to malloc. Strict ISO C
+       modes hide MAP_ANONYMOUS, build with _DEFAULT_SOURCE to keep it. */
+    #if defined(MAP_ANONYMOUS)
+      #define CLOMY__MMAP
+    #endif /* defined(MAP_ANONYMOUS) */
+    #define CLOMY_strcpy(dst, src, n) strncpy((dst), (src), (n))
+  #else
+    #define CLOMY_strcpy(dst, src, n) strncpy((dst), (src), (n))
+  #endif /* defined(_WIN32) */
 #endif /* define(CLOMY_PREFER_LIBC) */
 
 #ifndef CLOMY_ARENA_CAPACITY
 #define CLOMY_ARENA_CAPACITY (8 * 1024)
 #endif /* not CLOMY_ARENA_CAPACITY */
 
+/* Each new chunk doubles in size up to this cap. */
+#ifndef CLOMY_ARENA_MAX_CAPACITY
+#define CLOMY_ARENA_MAX_CAPACITY (64 * 1024 * 1024)
+#endif /* not CLOMY_ARENA_MAX_CAPACITY */
+
+/* Allocations this big get their own mapping. */
+#ifndef CLOMY_ARENA_HUGE_SIZE
+#define CLOMY_ARENA_HUGE_SIZE (1024 * 1024)
+#endif /* not CLOMY_ARENA_HUGE_SIZE */
+
+/* Size of a huge page for CLOMY_ARHUGEPAGE arenas. */
+#ifndef CLOMY_HUGEPAGE_SIZE
+#define CLOMY_HUGEPAGE_SIZE (2 * 1024 * 1024)
+#endif /* not CLOMY_HUGEPAGE_SIZE */
+
+/* Each new pool slab doubles in size up to CLOMY_POOL_MAX_CAPACITY. */
+#ifndef CLOMY_POOL_CAPACITY
+#define CLOMY_POOL_CAPACITY (4 * 1024)
+#endif /* not CLOMY_POOL_CAPACITY */
+
+#ifndef CLOMY_POOL_MAX_CAPACITY
+#define CLOMY_POOL_MAX_CAPACITY (256 * 1024)
+#endif /* not CLOMY_POOL_MAX_CAPACITY */
+
+/* Buckets moved by every put and delete while a hash table is resizing. */
+#ifndef CLOMY_HASHTABLE_REHASH_STEP
+#define CLOMY_HASHTABLE_REHASH_STEP 4
+#endif /* not CLOMY_HASHTABLE_REHASH_STEP */
+
+/* Hash functions of hash tables. Define them to plug in others. */
+#ifndef CLOMY_HASH_INT
+#define CLOMY_HASH_INT(seed, x) clomy_hashint ((U64)(x), (seed))
+#endif /* not CLOMY_HASH_INT */
+
+#ifndef CLOMY_HASH_STR
+#define CLOMY_HASH_STR(seed, s, n) clomy_hashbytes ((s), (n), (seed))
+#endif /* not CLOMY_HASH_STR */
+
+/* Room for the key in entries of pooled string key tables. Longer keys are
+   allocated separately. */
+#ifndef CLOMY_HASHTABLE_INLINE_KEY
+#define CLOMY_HASHTABLE_INLINE_KEY 24
+#endif /* not CLOMY_HASHTABLE_INLINE_KEY */
+
+/* Bucket lock stripes and deletes between reclaims of CLOMY_HTCONCURRENT
+   tables. The stripes must be a power of two. */
+#ifndef CLOMY_HASHTABLE_STRIPES
+#define CLOMY_HASHTABLE_STRIPES 64
+#endif /* not CLOMY_HASHTABLE_STRIPES */
+
+#ifndef CLOMY_HASHTABLE_RECLAIM
+#define CLOMY_HASHTABLE_RECLAIM 64
+#endif /* not CLOMY_HASHTABLE_RECLAIM */
+
+/* Keys whose buckets the batch hash table functions prefetch together. */
+#ifndef CLOMY_HASHTABLE_BATCH
+#define CLOMY_HASHTABLE_BATCH 16
+#endif /* not CLOMY_HASHTABLE_BATCH */
+
 #ifndef CLOMY_STRINGBUILDER_CAPACITY
 #define CLOMY_STRINGBUILDER_CAPACITY 1024
 #endif /* not CLOMY_STRINGBUILDER_CAPACITY */
@@ -73,6 +160,10 @@ CLOMY_strncpy_winapi (char *dst, const char *src, size_t n)
 #define CLOMY_ALLOC_MAGIC 0x00636E6B
 #endif /* not CLOMY_ALLOC_MAGIC */
 
+#ifndef CLOMY_FREE_MAGIC
+#define CLOMY_FREE_MAGIC 0x00667265
+#endif /* not CLOMY_FREE_MAGIC */
+
 #ifndef NULL
 #define NULL (void *)0
 #endif /* not NULL */
@@ -101,23 +192,23 @@ typedef signed long long S64;
 #ifndef CLOMY_TEST_DISABLE
 
 /* Utility to print error message. */
-#define CLOMY_FAIL(msg)                                                        \
-  do                                                                           \
-    {                                                                          \
-      fprintf (stderr, "%s:%d:0: Assertion failed: %s\n", __FILE__, __LINE__,  \
-               (msg));                                                         \
-      exit (1);                                                                \
-    }                                                                          \
+#define CLOMY_FAIL(msg)                                                       \
+  do                                                                          \
+    {                                                                         \
+      fprintf (stderr, "%s:%d:0: Assertion failed: %s\n", __FILE__, __LINE__, \
+               (msg));                                                        \
+      exit (1);                                                               \
+    }                                                                         \
   while (0);
 
 /* Utility to print error message if EXP is false. */
-#define CLOMY_FAILFALSE(exp, msg)                                              \
-  if (!(exp))                                                                  \
+#define CLOMY_FAILFALSE(exp, msg)                                             \
+  if (!(exp))                                                                 \
     CLOMY_FAIL ((msg));
 
 /* Utility to print error message if EXP is true. */
-#define CLOMY_FAILTRUE(exp, msg)                                               \
-  if ((exp))                                                                   \
+#define CLOMY_FAILTRUE(exp, msg)                                              \
+  if ((exp))                                                                  \
     CLOMY_FAIL ((msg));
 
 #else
@@ -130,18 +221,61 @@ typedef signed long long S64;
 
 /*--------------------[ Arena ]--------------------*/
 
+/* Free blocks are kept in arena-wide size-class bins. Blocks smaller than
+   CLOMY_ARENA_SMALL_SIZE get an exact bin per 8 byte step, larger blocks are
+   binned by power of two. */
+#define CLOMY_ARENA_BINS 128
+#define CLOMY_ARENA_SMALL_BINS 64
+#define CLOMY_ARENA_SMALL_SIZE (CLOMY_ARENA_SMALL_BINS * 8)
+
+/* Block flag: the block right before this one is free. */
+#define CLOMY_ARPREV_FREE 0x1
+
+/* Chunk flag: dedicated mapping of a single huge allocation. */
+#define CLOMY_CNKHUGE 0x1
+
+/* Chunk flag: carved from the reserved range of its arena. */
+#define CLOMY_CNKRESERVED 0x2
+
+/* Arena flag: pure bump allocation without per-allocation header. Memory is
+   only given back by clomy_arrewind or clomy_arfold. Set it before the first
+   allocation. */
+#define CLOMY_ARBUMP 0x1
+
+/* Arena flag: the arena is shared between threads (needs CLOMY_THREADS). Each
+   thread allocates from its own heap, frees of another thread's memory are
+   queued on the owning chunk and reclaimed by the owner on its next
+   allocation. Set it before the first allocation. */
+#define CLOMY_ARSHARED 0x2
+
+/* Arena flag: back chunks with huge pages. Chunks of at least
+   CLOMY_HUGEPAGE_SIZE try MAP_HUGETLB first, everything else falls back to
+   transparent huge pages through madvise. Only on Linux. */
+#define CLOMY_ARHUGEPAGE 0x4
+
+/* Arena flag: prefault chunks when they are mapped, so the first touch of a
+   page doesn't fault. Only on Linux. */
+#define CLOMY_ARPOPULATE 0x8
+
 typedef struct clomy_arfree_block
 {
-  size_t size;
-  struct clomy_arfree_block *next;
+  struct clomy_archunk *cnk;
+  size_t size; /* Size of the block including header. */
+  U32 magic;
+  U32 flags;
+  struct clomy_arfree_block *next, *prev;
 } clomy_arfree_block;
 
 typedef struct clomy_archunk
 {
   size_t size;
   size_t capacity;
-  clomy_arfree_block *free_list;
-  struct clomy_archunk *next;
+  struct clomy_arena *ar;
+  struct clomy_archunk *next, *prev;
+  size_t flags;
+#if defined(CLOMY_THREADS)
+  _Atomic (struct clomy_arfree_block *) rfree; /* Freed by other threads. */
+#endif /* defined(CLOMY_THREADS) */
   U8 data[];
 } clomy_archunk;
 
@@ -150,35 +284,181 @@ typedef struct clomy_aralloc_hdr
   struct clomy_archunk *cnk;
   size_t size;
   U32 magic;
+  U32 flags;
 } clomy_aralloc_hdr;
 
+/* Arena usage. The counters below largest_free are only kept with
+   CLOMY_ARENA_STATS. */
+typedef struct clomy_arstat
+{
+  size_t chunks;       /* Number of chunks. */
+  size_t huge_chunks;  /* Number of dedicated huge mappings. */
+  size_t mapped;       /* Bytes mapped by chunks, headers included. */
+  size_t huge_mapped;  /* Bytes mapped by huge allocations. */
+  size_t largest_free; /* Largest block in the bins, header included. */
+  size_t in_use;       /* Bytes handed out, headers included. */
+  size_t free;         /* Bytes in the bins. */
+  size_t allocs;       /* Number of allocations. */
+  size_t frees;        /* Number of frees. */
+  size_t new_chunks;   /* Allocations that had to map a new chunk. */
+} clomy_arstat;
+
 typedef struct clomy_arena
 {
   clomy_archunk *head, *tail;
+  clomy_archunk *huge;
+  size_t cnkcap;    /* Capacity of the next chunk. */
+  size_t reserve;   /* Address space to reserve up front, 0 for none. */
+  U8 *rsv;          /* Reserved range, committed up to rsvused. */
+  size_t rsvused;
+  size_t retain;    /* Bytes of chunks clomy_arreset keeps mapped. */
+  size_t highwater; /* Bytes clomy_arreset keeps resident, 0 for all. */
+  U32 flags;
+  clomy_arfree_block *bins[CLOMY_ARENA_BINS];
+  U64 binmap[CLOMY_ARENA_BINS / 64];
+#if defined(CLOMY_ARENA_STATS)
+  clomy_arstat stat;
+#endif /* defined(CLOMY_ARENA_STATS) */
+#if defined(CLOMY_THREADS)
+  _Atomic (U64) id;                     /* Shared arena: cache key. */
+  _Atomic (struct clomy_arena *) heaps; /* Shared arena: thread heaps. */
+  struct clomy_arena *parent, *sibling; /* Thread heap: shared arena. */
+  const void *owner;                    /* Thread heap: owning thread. */
+  _Atomic (size_t) remote;              /* Thread heap: queued frees. */
+#endif /* defined(CLOMY_THREADS) */
 } clomy_arena;
 
-clomy_archunk *_clomy_newarchunk (size_t size);
+#if defined(CLOMY_ARENA_STATS)
+#define CLOMY__ARCOUNT(ar, field, n) ((ar)->stat.field += (n))
+#else
+#define CLOMY__ARCOUNT(ar, field, n) ((void)0)
+#endif /* defined(CLOMY_ARENA_STATS) */
+
+/* Save point of a bump arena. */
+typedef struct clomy_arpos
+{
+  clomy_archunk *cnk;
+  size_t size;
+} clomy_arpos;
+
+U32 _clomy_log2 (U64 x);
+U32 _clomy_ctz (U64 x);
+
+#if defined(CLOMY__MMAP)
+void _clomy_aradvise (clomy_arena *ar, void *ptr, size_t size);
 
-clomy_arfree_block *_clomy_find_free_block (clomy_archunk *cnk,
-                                            size_t needed_size,
-                                            clomy_arfree_block **prev_ptr);
+void *_clomy_armap (clomy_arena *ar, size_t *size);
 
-void _clomy_remove_free_block (clomy_archunk *cnk, clomy_arfree_block *block,
-                               clomy_arfree_block *prev);
+void *_clomy_arcommit (clomy_arena *ar, size_t *size);
+
+void _clomy_ardecommit (void *ptr, size_t size);
+#endif /* defined(CLOMY__MMAP) */
+
+clomy_archunk *_clomy_newarchunk (clomy_arena *ar, size_t size, size_t flags);
+
+void _clomy_freearchunk (clomy_archunk *cnk);
+
+size_t _clomy_arnextcap (clomy_arena *ar, size_t size);
+
+size_t _clomy_arbin (size_t size);
+
+clomy_arfree_block *_clomy_find_free_block (clomy_arena *ar,
+                                            size_t needed_size);
+
+void _clomy_remove_free_block (clomy_arena *ar, clomy_arfree_block *block);
 
 void _clomy_add_free_block (clomy_archunk *cnk, clomy_arfree_block *new_block);
 
+void *_clomy_arbump (clomy_arena *ar, size_t size);
+
+void _clomy_arrelease (clomy_arena *ar, void *value);
+
+void _clomy_arfreehdr (clomy_aralloc_hdr *hdr);
+
+#if defined(CLOMY_THREADS)
+clomy_arena *_clomy_arheap (clomy_arena *ar);
+
+void _clomy_ardrain (clomy_arena *heap);
+#endif /* defined(CLOMY_THREADS) */
+
 /* Allocate memory inside arena. */
 void *clomy_aralloc (clomy_arena *ar, size_t size);
 
-/* Free the memory chunk inside arena. */
+/* Allocate memory inside arena aligned to ALIGN, a power of two. Resizing it
+   with clomy_arrealloc keeps the alignment only while it grows in place. */
+void *clomy_aralloc_aligned (clomy_arena *ar, size_t size, size_t align);
+
+/* Free the memory chunk inside arena. Not for CLOMY_ARBUMP arenas. May be
+   called from any thread for CLOMY_ARSHARED arenas. */
 void clomy_arfree (void *value);
 
-/* Free the entire arena. */
+/* Resize VALUE from OLD_SIZE to SIZE without moving it. Returns 1 when it can
+   not be done in place. */
+int clomy_arextend (clomy_arena *ar, void *value, size_t old_size,
+                    size_t size);
+
+/* Resize VALUE from OLD_SIZE to SIZE, moving it only when it can not grow in
+   place. */
+void *clomy_arrealloc (clomy_arena *ar, void *value, size_t old_size,
+                       size_t size);
+
+/* Save the current position of a CLOMY_ARBUMP arena. */
+clomy_arpos clomy_armark (clomy_arena *ar);
+
+/* Release everything allocated since POS, keeping the chunks mapped. */
+void clomy_arrewind (clomy_arena *ar, clomy_arpos pos);
+
+/* Get the chunk usage of arena. */
+void clomy_arstats (clomy_arena *ar, clomy_arstat *st);
+
+#if defined(CLOMY_ARENA_STATS)
+/* Print the usage of every chunk with a histogram of its free blocks. */
+void clomy_ardump (clomy_arena *ar, FILE *out);
+#endif /* defined(CLOMY_ARENA_STATS) */
+
+/* Free everything allocated in the arena, keeping up to RETAIN bytes of
+   chunks mapped for the next round. Pages past HIGHWATER bytes of the kept
+   chunks are lazily given back to the kernel. For CLOMY_ARSHARED arenas no
+   other thread may use it meanwhile. */
+void clomy_arreset (clomy_arena *ar);
+
+/* Free the entire arena. For CLOMY_ARSHARED arenas no other thread may use
+   it meanwhile. */
 void clomy_arfold (clomy_arena *ar);
 
+/*--------------------[ Object Pool ]--------------------*/
+
+/* Fixed-size objects carved from arena slabs, without per-object header. */
+typedef struct clomy_pool
+{
+  clomy_arena *ar;
+  size_t size;    /* Object size. */
+  size_t slabcap; /* Capacity of the next slab. */
+  void *free;     /* Freed objects, linked through their first word. */
+  U8 *cur, *end;  /* Unused part of the current slab. */
+  void *slabs;    /* Slabs, linked through their first word. */
+} clomy_pool;
+
+/* Initialize the pool for objects of SIZE bytes in arena. */
+int clomy_poolinit (clomy_pool *pl, clomy_arena *ar, size_t size);
+
+/* Allocate an object from the pool. */
+void *clomy_poolalloc (clomy_pool *pl);
+
+/* Give an object back to the pool. */
+void clomy_poolfree (clomy_pool *pl, void *value);
+
+/* Free the pool and all of its objects. */
+void clomy_poolfold (clomy_pool *pl);
+
 /*--------------------[ Dynamic Array ]--------------------*/
 
+/* Dynamic array flag: the elements are kept in a ring buffer, so putting and
+   taking them at either end is constant time, clomy_dapop included. Index
+   through clomy_daget, the elements may wrap around the end of data. The
+   capacity is kept a power of two. Set it before clomy_dainit. */
+#define CLOMY_DARING 0x1
+
 typedef struct clomy_da
 {
   clomy_arena *ar;
@@ -186,11 +466,13 @@ typedef struct clomy_da
   size_t data_size;
   size_t size;
   size_t capacity;
+  size_t head; /* Slot of the first element of CLOMY_DARING arrays. */
+  U32 flags;
 } clomy_da;
 
 /* Initialize the dynamic array in arena. */
 int clomy_dainit (clomy_da *da, clomy_arena *ar, size_t data_size,
-                  size_t capacity);
+    size_t capacity);
 
 /* Set the capacity of dynamic array. */
 int clomy_dacap (clomy_da *da, size_t capacity);
@@ -198,6 +480,12 @@ int clomy_dacap (clomy_da *da, size_t capacity);
 /* Doubles the capacity of the array. */
 int clomy_dagrow (clomy_da *da);
 
+/* Make the capacity at least CAPACITY, doubling it as often as needed. */
+int clomy_dareserve (clomy_da *da, size_t capacity);
+
+/* Set the size of the array, new elements are zeroed. */
+int clomy_daresize (clomy_da *da, size_t size);
+
 /* Get Ith element of dynamic array. */
 void *clomy_daget (clomy_da *da, size_t i);
 inline int clomy_daget_int (clomy_da *da, size_t i);
@@ -218,6 +506,9 @@ inline int clomy_daappend_char (clomy_da *da, char data);
 inline int clomy_daappend_short (clomy_da *da, short data);
 /**/
 
+/* Append N elements from DATA at the end of dynamic array. */
+int clomy_daappend_n (clomy_da *da, const void *data, size_t n);
+
 /* Append data at the start of dynamic array.*/
 int clomy_dapush (clomy_da *da, void *data);
 inline int clomy_dapush_int (clomy_da *da, int data);
@@ -238,10 +529,26 @@ inline int clomy_dainsert_char (clomy_da *da, size_t i, char data);
 inline int clomy_dainsert_short (clomy_da *da, size_t i, short data);
 /**/
 
+/* Insert N elements from DATA at Ith position of dynamic array. */
+int clomy_dainsert_range (clomy_da *da, size_t i, const void *data,
+                          size_t n);
+
 /* Delete data at Ith position of dynamic array. */
 void clomy_dadel (clomy_da *da, size_t i);
 
-/* Delete data at front of the dynamic array and returns the data. */
+/* Delete N elements from Ith position of dynamic array. */
+void clomy_dadel_range (clomy_da *da, size_t i, size_t n);
+
+/* Copy N elements from DATA, or zeros if NULL, to the Ith position. */
+void _clomy_daput (clomy_da *da, size_t i, const void *data, size_t n);
+
+/* Delete data at front of the dynamic array, copying it to OUT unless OUT
+   is NULL. Returns 1 if the array is empty. */
+int clomy_datake (clomy_da *da, void *out);
+
+/* Delete data at front of the dynamic array and return a copy allocated in
+   its arena. The typed versions return the value and allocate nothing, 0 if
+   the array is empty. */
 void *clomy_dapop (clomy_da *da);
 inline int clomy_dapop_int (clomy_da *da);
 inline float clomy_dapop_float (clomy_da *da);
@@ -284,55 +591,498 @@ inline short clomy_dalast_short (clomy_da *da);
 /* Free the dynamic array. */
 void clomy_dafold (clomy_da *da);
 
+/* Grow DATA, an array of CAPACITY elements of ELEM bytes, to hold SIZE of
+   them by doubling CAPACITY. Returns the new array or NULL. */
+void *_clomy_tdagrow (clomy_arena *ar, void *data, size_t *capacity,
+                      size_t elem, size_t size);
+
+/* Declare clomy_da_NAME, a dynamic array of T. Unlike clomy_da the element
+   size is known at compile time and DATA is a plain T array, so loops over
+   data[0] to data[size - 1] can be unrolled and vectorized. It has no ring
+   mode. Arrays of the basic types are declared already, with short
+   names. */
+#define CLOMY_DA_DECLARE(T, name)                                             \
+  typedef struct clomy_da_##name                                              \
+  {                                                                           \
+    clomy_arena *ar;                                                          \
+    T *data;                                                                  \
+    size_t size;                                                              \
+    size_t capacity;                                                          \
+  } clomy_da_##name;                                                          \
+                                                                              \
+  static inline int clomy_da_##name##_reserve (clomy_da_##name *da,           \
+                                               size_t capacity)               \
+  {                                                                           \
+    T *data;                                                                  \
+                                                                              \
+    if (capacity <= da->capacity)                                             \
+      return 0;                                                               \
+                                                                              \
+    data = (T *)_clomy_tdagrow (da->ar, da->data, &da->capacity, sizeof (T),  \
+                                capacity);                                    \
+    if (!data)                                                                \
+      return 1;                                                               \
+                                                                              \
+    da->data = data;                                                          \
+    return 0;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline int clomy_da_##name##_init (clomy_da_##name *da,              \
+                                            clomy_arena *ar, size_t capacity) \
+  {                                                                           \
+    CLOMY_FAILFALSE (ar, "Arena is required.");                               \
+                                                                              \
+    da->ar = ar;                                                              \
+    da->data = NULL;                                                          \
+    da->size = 0;                                                             \
+    da->capacity = 0;                                                         \
+                                                                              \
+    return clomy_da_##name##_reserve (da, capacity);                          \
+  }                                                                           \
+                                                                              \
+  static inline int clomy_da_##name##_resize (clomy_da_##name *da,            \
+                                              size_t size)                    \
+  {                                                                           \
+    if (clomy_da_##name##_reserve (da, size))                                 \
+      return 1;                                                               \
+                                                                              \
+    if (size > da->size)                                                      \
+      memset (da->data + da->size, 0, (size - da->size) * sizeof (T));        \
+                                                                              \
+    da->size = size;                                                          \
+    return 0;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline int clomy_da_##name##_append (clomy_da_##name *da, T data)    \
+  {                                                                           \
+    if (clomy_da_##name##_reserve (da, da->size + 1))                         \
+      return 1;                                                               \
+                                                                              \
+    da->data[da->size++] = data;                                              \
+    return 0;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline int clomy_da_##name##_append_n (clomy_da_##name *da,          \
+                                                const T *data, size_t n)      \
+  {                                                                           \
+    if (clomy_da_##name##_reserve (da, da->size + n))                         \
+      return 1;                                                               \
+                                                                              \
+    memcpy (da->data + da->size, data, n * sizeof (T));                       \
+    da->size += n;                                                            \
+    return 0;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline int clomy_da_##name##_insert (clomy_da_##name *da, size_t i,  \
+                                              T data)                         \
+  {                                                                           \
+    if (i > da->size || clomy_da_##name##_reserve (da, da->size + 1))         \
+      return 1;                                                               \
+                                                                              \
+    memmove (da->data + i + 1, da->data + i, (da->size - i) * sizeof (T));    \
+    da->data[i] = data;                                                       \
+    ++da->size;                                                               \
+    return 0;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline void clomy_da_##name##_del (clomy_da_##name *da, size_t i)    \
+  {                                                                           \
+    if (i >= da->size)                                                        \
+      return;                                                                 \
+                                                                              \
+    memmove (da->data + i, da->data + i + 1,                                  \
+             (da->size - i - 1) * sizeof (T));                                \
+    --da->size;                                                               \
+  }                                                                           \
+                                                                              \
+  static inline void clomy_da_##name##_fold (clomy_da_##name *da)             \
+  {                                                                           \
+    if (da->data)                                                             \
+      _clomy_arrelease (da->ar, da->data);                                    \
+                                                                              \
+    da->data = NULL;                                                          \
+    da->size = 0;                                                             \
+    da->capacity = 0;                                                         \
+  }
+
+CLOMY_DA_DECLARE (int, int)
+CLOMY_DA_DECLARE (float, float)
+CLOMY_DA_DECLARE (long, long)
+CLOMY_DA_DECLARE (double, double)
+CLOMY_DA_DECLARE (char, char)
+CLOMY_DA_DECLARE (short, short)
+/**/
+
+/* Comparisons counted by clomy_da_T_count, combine them for <=, >= and !=. */
+#define CLOMY_CMPLT 0x1
+#define CLOMY_CMPEQ 0x2
+#define CLOMY_CMPGT 0x4
+
+/* The numeric kernels below work on the typed arrays. On x86-64 Linux each
+   one is built for SSE2, AVX2 and AVX-512, the best for the CPU is picked
+   when the program is loaded. Integer arithmetic is done unsigned, so
+   results wrap around instead of overflowing. */
+
+/* Sum of the elements. */
+int clomy_da_int_sum (clomy_da_int *da);
+float clomy_da_float_sum (clomy_da_float *da);
+long clomy_da_long_sum (clomy_da_long *da);
+double clomy_da_double_sum (clomy_da_double *da);
+short clomy_da_short_sum (clomy_da_short *da);
+/**/
+
+/* Smallest and largest element, 0 for empty arrays. */
+int clomy_da_int_min (clomy_da_int *da);
+int clomy_da_int_max (clomy_da_int *da);
+float clomy_da_float_min (clomy_da_float *da);
+float clomy_da_float_max (clomy_da_float *da);
+long clomy_da_long_min (clomy_da_long *da);
+long clomy_da_long_max (clomy_da_long *da);
+double clomy_da_double_min (clomy_da_double *da);
+double clomy_da_double_max (clomy_da_double *da);
+short clomy_da_short_min (clomy_da_short *da);
+short clomy_da_short_max (clomy_da_short *da);
+/**/
+
+/* Dot product of two arrays of the same size. */
+int clomy_da_int_dot (clomy_da_int *a, clomy_da_int *b);
+float clomy_da_float_dot (clomy_da_float *a, clomy_da_float *b);
+long clomy_da_long_dot (clomy_da_long *a, clomy_da_long *b);
+double clomy_da_double_dot (clomy_da_double *a, clomy_da_double *b);
+short clomy_da_short_dot (clomy_da_short *a, clomy_da_short *b);
+/**/
+
+/* Multiply every element by K. */
+void clomy_da_int_scale (clomy_da_int *da, int k);
+void clomy_da_float_scale (clomy_da_float *da, float k);
+void clomy_da_long_scale (clomy_da_long *da, long k);
+void clomy_da_double_scale (clomy_da_double *da, double k);
+void clomy_da_short_scale (clomy_da_short *da, short k);
+/**/
+
+/* Add SRC to DST element-wise, both of the same size. */
+void clomy_da_int_add (clomy_da_int *dst, clomy_da_int *src);
+void clomy_da_float_add (clomy_da_float *dst, clomy_da_float *src);
+void clomy_da_long_add (clomy_da_long *dst, clomy_da_long *src);
+void clomy_da_double_add (clomy_da_double *dst, clomy_da_double *src);
+void clomy_da_short_add (clomy_da_short *dst, clomy_da_short *src);
+/**/
+
+/* Replace every element with the sum of it and all the ones before it. */
+void clomy_da_int_prefix_sum (clomy_da_int *da);
+void clomy_da_float_prefix_sum (clomy_da_float *da);
+void clomy_da_long_prefix_sum (clomy_da_long *da);
+void clomy_da_double_prefix_sum (clomy_da_double *da);
+void clomy_da_short_prefix_sum (clomy_da_short *da);
+/**/
+
+/* Count elements comparing to VALUE as CMP, an OR of CLOMY_CMP* flags. */
+size_t clomy_da_int_count (clomy_da_int *da, int cmp, int value);
+size_t clomy_da_float_count (clomy_da_float *da, int cmp, float value);
+size_t clomy_da_long_count (clomy_da_long *da, int cmp, long value);
+size_t clomy_da_double_count (clomy_da_double *da, int cmp, double value);
+size_t clomy_da_short_count (clomy_da_short *da, int cmp, short value);
+/**/
+
 /*--------------------[ Hash Table ]--------------------*/
 
 typedef struct clomy_htdata
 {
-  int key;
+  U64 key;
   struct clomy_htdata *next;
   U8 data[];
 } clomy_htdata;
 
 typedef struct clomy_stdata
 {
-  char *key;
+  char *key; /* Usually stored in the entry, after the value. */
   struct clomy_stdata *next;
+  U64 hash;
+  size_t keylen;
   U8 data[];
 } clomy_stdata;
 
+/* Hash table flag: allocate the entries from a clomy_pool. Set it before
+   clomy_htinit. */
+#define CLOMY_HTPOOL 0x1
+
+/* Hash table flag: open addressing with the entries stored inline and probed
+   16 control bytes at a time. The table grows at 7/8 load, so pointers from
+   clomy_htget are only valid until the next put. Putting an existing key
+   replaces its value. Integer keys only. Set it before clomy_htinit. */
+#define CLOMY_HTOPEN 0x2
+
+/* Hash table flag: the table is shared between threads (needs CLOMY_THREADS
+   and a CLOMY_ARSHARED arena). Lookups never block, writers lock a stripe of
+   buckets and deleted entries are freed once no reader can see them. The
+   table doesn't resize, so give clomy_htinit the expected size. Pointers
+   from get and upsert stay valid between clomy_htenter and clomy_htleave.
+   Put on an existing key writes the value in place under the stripe lock,
+   like clomy_htinc_int. Chained tables only, set it before clomy_htinit. */
+#define CLOMY_HTCONCURRENT 0x4
+
+/* Hash table flag: hash with the seed already in the table instead of a new
+   one, for reproducible layouts. Set it and seed before clomy_htinit. */
+#define CLOMY_HTSEED 0x8
+
+/* Hash table flag: entries live in one array in put order and the buckets
+   point into it, so clomy_ht_foreach and clomy_st_foreach read memory in
+   order and visit keys in put order. Deletes leave holes that are packed
+   when the array is full, so pointers from get are only valid until the
+   next put. Chained tables without a pool only, set it before
+   clomy_htinit. */
+#define CLOMY_HTDENSE 0x10
+
+/* Control bytes of CLOMY_HTOPEN tables. Full slots hold 7 bits of the hash. */
+#define CLOMY_HTEMPTY 0x80
+#define CLOMY_HTDELETED 0xFE
+#define CLOMY_HTGROUP 16
+
+/* Slot of CLOMY_HTOPEN tables: the key, then the value 8 bytes in. */
+#define CLOMY_HTSLOT_SIZE(ht) (8 + CLOMY_ALIGN_UP ((ht)->data_size, 8))
+
+/* Key stored inline in a string key entry. */
+#define CLOMY_STKEY(ht, d)                                                    \
+  ((char *)(d)->data + CLOMY_ALIGN_UP ((ht)->data_size, 8))
+
+#if defined(CLOMY_THREADS)
+typedef struct clomy_htreader
+{
+  _Atomic (U64) epoch; /* Epoch the thread entered at, 0 when outside. */
+  size_t depth;
+  void *owner;
+  struct clomy_htreader *next;
+} clomy_htreader;
+
+typedef struct clomy_htretired
+{
+  void *data;
+  U64 epoch; /* Epoch it was unlinked at. */
+  int str;   /* A clomy_stdata entry. */
+  struct clomy_htretired *next;
+} clomy_htretired;
+#endif /* defined(CLOMY_THREADS) */
+
 typedef struct clomy_ht
 {
   clomy_arena *ar;
   void **data;
   size_t data_size;
+  size_t key_size; /* Key size of byte blob key tables. */
   size_t size;
   size_t capacity;
-  U32 a;
+  U64 seed;
+  U32 flags;
+  clomy_pool nodes; /* Entries of CLOMY_HTPOOL tables. */
+  U8 *ctrl;         /* Control bytes of CLOMY_HTOPEN tables. */
+  size_t deleted;   /* Deleted slots of CLOMY_HTOPEN tables. */
+  void **old;       /* Buckets being rehashed into data. */
+  size_t oldcap;
+  size_t moved;     /* Buckets of old already rehashed. */
+  U8 *entries;      /* Entries of CLOMY_HTDENSE tables, in put order. */
+  size_t used;      /* Dense: entries put, deleted ones included. */
+  size_t room;
+  size_t stride;
+#if defined(CLOMY_THREADS)
+  U64 id;                                 /* Concurrent: reader cache key. */
+  atomic_flag *locks;                     /* Concurrent: bucket stripes. */
+  _Atomic (U64) epoch;                    /* Concurrent: deletes so far. */
+  _Atomic (clomy_htreader *) readers;     /* Concurrent: one per thread. */
+  atomic_flag retiring;                   /* Concurrent: guards retired. */
+  clomy_htretired *retired;               /* Concurrent: not freed yet. */
+  size_t nretired;
+#endif /* defined(CLOMY_THREADS) */
 } clomy_ht;
 
 /* Loop through each item of hash table. */
-#define clomy_ht_foreach(t, k, body)                                           \
-  for (U32 __i = 0; __i < (t)->capacity; ++__i)                                \
-    for (clomy_htdata *__data = (t)->data[__i]; __data; __data = __data->next) \
-      {                                                                        \
-        (k) = __data->key;                                                     \
-        body                                                                   \
-      }
-#define clomy_st_foreach(t, k, body)                                           \
-  for (U32 __i = 0; __i < (t)->capacity; ++__i)                                \
-    for (clomy_stdata *__data = (t)->data[__i]; __data; __data = __data->next) \
-      {                                                                        \
-        (k) = __data->key;                                                     \
-        body                                                                   \
-      }
-U32 _clomy_hash_int (clomy_ht *ht, int x);
-U32 _clomy_hash_str (clomy_ht *ht, char *x);
+#define clomy_ht_foreach(t, k, body)                                          \
+  do                                                                          \
+    {                                                                         \
+      if ((t)->flags & CLOMY_HTOPEN)                                          \
+        for (U32 __i = 0; __i < (t)->capacity; ++__i)                         \
+          {                                                                   \
+            if ((t)->ctrl[__i] & CLOMY_HTEMPTY)                               \
+              continue;                                                       \
+            (k) = *(U64 *)((U8 *)(t)->data + __i * CLOMY_HTSLOT_SIZE (t));    \
+            body                                                              \
+          }                                                                   \
+      else if ((t)->flags & CLOMY_HTDENSE)                                    \
+        for (size_t __i = 0; __i < (t)->used; ++__i)                          \
+          {                                                                   \
+            clomy_htdata *__data                                              \
+                = (clomy_htdata *)((t)->entries + __i * (t)->stride);         \
+            if (__data->next == __data)                                       \
+              continue;                                                       \
+            (k) = __data->key;                                                \
+            body                                                              \
+          }                                                                   \
+      else                                                                    \
+        for (U32 __i = 0; __i < (t)->capacity + (t)->oldcap; ++__i)           \
+          for (clomy_htdata *__data = __i < (t)->capacity                     \
+                  ? (t)->data[__i] : (t)->old[__i - (t)->capacity];           \
+              __data; __data = __data->next)                                  \
+          {                                                                   \
+            (k) = __data->key;                                                \
+            body                                                              \
+          }                                                                   \
+    }                                                                         \
+  while (0)
+
+#define clomy_st_foreach(t, k, body)                                          \
+  do                                                                          \
+    {                                                                         \
+      if ((t)->flags & CLOMY_HTDENSE)                                         \
+        for (size_t __i = 0; __i < (t)->used; ++__i)                          \
+          {                                                                   \
+            clomy_stdata *__data                                              \
+                = (clomy_stdata *)((t)->entries + __i * (t)->stride);         \
+            if (__data->next == __data)                                       \
+              continue;                                                       \
+            (k) = __data->key;                                                \
+            body                                                              \
+          }                                                                   \
+      else                                                                    \
+        for (U32 __i = 0; __i < (t)->capacity + (t)->oldcap; ++__i)           \
+          for (clomy_stdata *__data = __i < (t)->capacity                     \
+                  ? (t)->data[__i] : (t)->old[__i - (t)->capacity];           \
+              __data; __data = __data->next)                                  \
+          {                                                                   \
+            (k) = __data->key;                                                \
+            body                                                              \
+          }                                                                   \
+    }                                                                         \
+  while (0)
+
+/* Hash X with SEED. */
+U64 clomy_hashint (U64 x, U64 seed);
+
+/* Hash N bytes at DATA with SEED. */
+U64 clomy_hashbytes (const void *data, size_t n, U64 seed);
+
+U64 _clomy_mum (U64 a, U64 b);
+U64 _clomy_read64 (const U8 *p);
+U64 _clomy_read32 (const U8 *p);
+
+U64 _clomy_hash_int (clomy_ht *ht, U64 x);
+U64 _clomy_hash_str (clomy_ht *ht, const char *x, size_t n);
+
+int _clomy_stmatch (clomy_stdata *data, const char *key, size_t n,
+                    U64 hash);
+
+void _clomy_stfree (clomy_ht *ht, clomy_stdata *data);
+
+/* New entry of SIZE bytes, STR if a clomy_stdata. */
+void *_clomy_htnew (clomy_ht *ht, size_t size, int str);
+
+void _clomy_htfree (clomy_ht *ht, void *data);
+
+int _clomy_htpack (clomy_ht *ht, int str);
+
+int _clomy_htresize (clomy_ht *ht, size_t capacity);
+void _clomy_htshrink (clomy_ht *ht);
+
+void _clomy_htmove (clomy_ht *ht, size_t i);
+void _clomy_stmove (clomy_ht *ht, size_t i);
+
+void _clomy_htstep (clomy_ht *ht, U64 hash);
+void _clomy_ststep (clomy_ht *ht, U64 hash);
+
+U32 _clomy_htgroup (const U8 *ctrl, U8 c);
+
+U32 _clomy_htgroupfree (const U8 *ctrl);
+
+void _clomy_htsetctrl (clomy_ht *ht, size_t i, U8 c);
+
+U8 *_clomy_htfind (clomy_ht *ht, U64 key, U64 hash);
+
+size_t _clomy_htfindfree (clomy_ht *ht, U64 hash);
+
+int _clomy_htrehash (clomy_ht *ht, size_t capacity);
+
+void *_clomy_htoupsert (clomy_ht *ht, U64 key, U64 hash, int *isnew);
+
+U64 _clomy_htseed (clomy_ht *ht);
+
+clomy_htdata *_clomy_htnode (clomy_ht *ht, U64 key);
+clomy_stdata *_clomy_stnode (clomy_ht *ht, const char *key, size_t n,
+                             U64 hash);
+
+/* Prefetch the bucket of HASH or, with NODE, the first entry of its chain.
+   The bucket should be in cache by then. */
+void _clomy_htprefetch (clomy_ht *ht, U64 hash, int node);
+
+struct clomy_string;
+
+/* Hash N keys into HASH and prefetch their buckets. */
+void _clomy_hthashbatch (clomy_ht *ht, const int *keys, size_t n,
+                                 U64 *hash);
+void _clomy_u64hashbatch (clomy_ht *ht, const U64 *keys, size_t n,
+                                 U64 *hash);
+void _clomy_s64hashbatch (clomy_ht *ht, const S64 *keys, size_t n,
+                                 U64 *hash);
+void _clomy_sthashbatch (clomy_ht *ht, char *const *keys, size_t n,
+                                 U64 *hash);
+void _clomy_strhashbatch (clomy_ht *ht, struct clomy_string *const *keys, size_t n,
+                                 U64 *hash);
+void _clomy_bthashbatch (clomy_ht *ht, const void *const *keys, size_t n,
+                                 U64 *hash);
+/**/
+
+#if defined(CLOMY_THREADS)
+void _clomy_htlock (atomic_flag *lock);
+void _clomy_htunlock (atomic_flag *lock);
+
+clomy_htreader *_clomy_htreader (clomy_ht *ht);
+
+void _clomy_htretire (clomy_ht *ht, void *data, int str);
+void _clomy_htreclaim (clomy_ht *ht, int all);
+void _clomy_htcfold (clomy_ht *ht);
+
+void *_clomy_htcput (clomy_ht *ht, U64 key, void *value, int *isnew);
+void *_clomy_stcput (clomy_ht *ht, const char *key, size_t n, void *value,
+                     int *isnew);
+
+void *_clomy_htcget (clomy_ht *ht, U64 key);
+void *_clomy_stcget (clomy_ht *ht, const char *key, size_t n);
+
+/* Increment the integer value of KEY under its stripe lock. */
+int _clomy_htcinc (clomy_ht *ht, U64 key);
+int _clomy_stcinc (clomy_ht *ht, const char *key, size_t n);
+
+void _clomy_htcdel (clomy_ht *ht, U64 key);
+void _clomy_stcdel (clomy_ht *ht, const char *key, size_t n);
+#endif /* defined(CLOMY_THREADS) */
+
+/* Key type independent parts of the hash table functions. */
+void *_clomy_htupsert (clomy_ht *ht, U64 key, int *isnew);
+void *_clomy_stupsert (clomy_ht *ht, const char *key, size_t n, int *isnew);
+
+void *_clomy_htget (clomy_ht *ht, U64 key);
+void *_clomy_stget (clomy_ht *ht, const char *key, size_t n);
+
+/* Same as above with the hash of KEY given. */
+void *_clomy_htupserth (clomy_ht *ht, U64 key, U64 hash, int *isnew);
+void *_clomy_stupserth (clomy_ht *ht, const char *key, size_t n, U64 hash,
+                        int *isnew);
+
+void *_clomy_htgeth (clomy_ht *ht, U64 key, U64 hash);
+void *_clomy_stgeth (clomy_ht *ht, const char *key, size_t n, U64 hash);
+
+void _clomy_htdel (clomy_ht *ht, U64 key);
+void _clomy_stdel (clomy_ht *ht, const char *key, size_t n);
 
 /* Initialize hash table. */
 int clomy_htinit (clomy_ht *ht, clomy_arena *ar, size_t capacity, size_t dsize);
 
-/* Put value in KEY in hash table. */
+/* Initialize hash table with byte blob keys of KSIZE bytes. */
+int clomy_btinit (clomy_ht *ht, clomy_arena *ar, size_t capacity,
+                  size_t ksize, size_t dsize);
 
+/* Each key type has its own functions: ht (int), u64, s64, st (C string),
+   str (clomy_string) and bt (byte blob). Walk integer key tables with
+   clomy_ht_foreach and the others with clomy_st_foreach. */
+
+/* Put value in KEY in hash table, replacing the old value. */
 int clomy_htput (clomy_ht *ht, int key, void *value);
 inline int clomy_htput_int (clomy_ht *table, int key, int val);
 inline int clomy_htput_float (clomy_ht *table, int key, float val);
@@ -340,22 +1090,63 @@ inline int clomy_htput_long (clomy_ht *table, int key, long val);
 inline int clomy_htput_double (clomy_ht *table, int key, double val);
 inline int clomy_htput_char (clomy_ht *table, int key, char val);
 inline int clomy_htput_short (clomy_ht *table, int key, short val);
-
-int clomy_stput (clomy_ht *st, char *key, void *value);
+int clomy_u64put (clomy_ht *ht, U64 key, void *value);
+inline int clomy_u64put_int (clomy_ht *table, U64 key, int val);
+inline int clomy_u64put_float (clomy_ht *table, U64 key, float val);
+inline int clomy_u64put_long (clomy_ht *table, U64 key, long val);
+inline int clomy_u64put_double (clomy_ht *table, U64 key, double val);
+inline int clomy_u64put_char (clomy_ht *table, U64 key, char val);
+inline int clomy_u64put_short (clomy_ht *table, U64 key, short val);
+int clomy_s64put (clomy_ht *ht, S64 key, void *value);
+inline int clomy_s64put_int (clomy_ht *table, S64 key, int val);
+inline int clomy_s64put_float (clomy_ht *table, S64 key, float val);
+inline int clomy_s64put_long (clomy_ht *table, S64 key, long val);
+inline int clomy_s64put_double (clomy_ht *table, S64 key, double val);
+inline int clomy_s64put_char (clomy_ht *table, S64 key, char val);
+inline int clomy_s64put_short (clomy_ht *table, S64 key, short val);
+int clomy_stput (clomy_ht *ht, char *key, void *value);
 inline int clomy_stput_int (clomy_ht *table, char *key, int val);
 inline int clomy_stput_float (clomy_ht *table, char *key, float val);
 inline int clomy_stput_long (clomy_ht *table, char *key, long val);
 inline int clomy_stput_double (clomy_ht *table, char *key, double val);
 inline int clomy_stput_char (clomy_ht *table, char *key, char val);
 inline int clomy_stput_short (clomy_ht *table, char *key, short val);
+int clomy_strput (clomy_ht *ht, struct clomy_string *key, void *value);
+inline int clomy_strput_int (clomy_ht *table, struct clomy_string *key, int val);
+inline int clomy_strput_float (clomy_ht *table, struct clomy_string *key, float val);
+inline int clomy_strput_long (clomy_ht *table, struct clomy_string *key, long val);
+inline int clomy_strput_double (clomy_ht *table, struct clomy_string *key, double val);
+inline int clomy_strput_char (clomy_ht *table, struct clomy_string *key, char val);
+inline int clomy_strput_short (clomy_ht *table, struct clomy_string *key, short val);
+int clomy_btput (clomy_ht *ht, const void *key, void *value);
+inline int clomy_btput_int (clomy_ht *table, const void *key, int val);
+inline int clomy_btput_float (clomy_ht *table, const void *key, float val);
+inline int clomy_btput_long (clomy_ht *table, const void *key, long val);
+inline int clomy_btput_double (clomy_ht *table, const void *key, double val);
+inline int clomy_btput_char (clomy_ht *table, const void *key, char val);
+inline int clomy_btput_short (clomy_ht *table, const void *key, short val);
+/**/
+
+/* Get value for KEY, putting a zeroed one if it doesn't exist. ISNEW, if
+   not NULL, is set to whether the key was put. */
+void *clomy_htupsert (clomy_ht *ht, int key, int *isnew);
+void *clomy_u64upsert (clomy_ht *ht, U64 key, int *isnew);
+void *clomy_s64upsert (clomy_ht *ht, S64 key, int *isnew);
+void *clomy_stupsert (clomy_ht *ht, char *key, int *isnew);
+void *clomy_strupsert (clomy_ht *ht, struct clomy_string *key, int *isnew);
+void *clomy_btupsert (clomy_ht *ht, const void *key, int *isnew);
 /**/
 
 /* Set integer value 1 if key doesn't exist, increment it otherwise. */
 inline int clomy_htinc_int (clomy_ht *ht, int key);
+inline int clomy_u64inc_int (clomy_ht *ht, U64 key);
+inline int clomy_s64inc_int (clomy_ht *ht, S64 key);
 inline int clomy_stinc_int (clomy_ht *ht, char *key);
+inline int clomy_strinc_int (clomy_ht *ht, struct clomy_string *key);
+inline int clomy_btinc_int (clomy_ht *ht, const void *key);
+/**/
 
 /* Get value for KEY Hash table. */
-
 void *clomy_htget (clomy_ht *ht, int key);
 inline int *clomy_htget_int (clomy_ht *ht, int key);
 inline float *clomy_htget_float (clomy_ht *ht, int key);
@@ -363,31 +1154,106 @@ inline long *clomy_htget_long (clomy_ht *ht, int key);
 inline double *clomy_htget_double (clomy_ht *ht, int key);
 inline char *clomy_htget_char (clomy_ht *ht, int key);
 inline short *clomy_htget_short (clomy_ht *ht, int key);
+void *clomy_u64get (clomy_ht *ht, U64 key);
+inline int *clomy_u64get_int (clomy_ht *ht, U64 key);
+inline float *clomy_u64get_float (clomy_ht *ht, U64 key);
+inline long *clomy_u64get_long (clomy_ht *ht, U64 key);
+inline double *clomy_u64get_double (clomy_ht *ht, U64 key);
+inline char *clomy_u64get_char (clomy_ht *ht, U64 key);
+inline short *clomy_u64get_short (clomy_ht *ht, U64 key);
+void *clomy_s64get (clomy_ht *ht, S64 key);
+inline int *clomy_s64get_int (clomy_ht *ht, S64 key);
+inline float *clomy_s64get_float (clomy_ht *ht, S64 key);
+inline long *clomy_s64get_long (clomy_ht *ht, S64 key);
+inline double *clomy_s64get_double (clomy_ht *ht, S64 key);
+inline char *clomy_s64get_char (clomy_ht *ht, S64 key);
+inline short *clomy_s64get_short (clomy_ht *ht, S64 key);
+void *clomy_stget (clomy_ht *ht, char *key);
+inline int *clomy_stget_int (clomy_ht *ht, char *key);
+inline float *clomy_stget_float (clomy_ht *ht, char *key);
+inline long *clomy_stget_long (clomy_ht *ht, char *key);
+inline double *clomy_stget_double (clomy_ht *ht, char *key);
+inline char *clomy_stget_char (clomy_ht *ht, char *key);
+inline short *clomy_stget_short (clomy_ht *ht, char *key);
+void *clomy_strget (clomy_ht *ht, struct clomy_string *key);
+inline int *clomy_strget_int (clomy_ht *ht, struct clomy_string *key);
+inline float *clomy_strget_float (clomy_ht *ht, struct clomy_string *key);
+inline long *clomy_strget_long (clomy_ht *ht, struct clomy_string *key);
+inline double *clomy_strget_double (clomy_ht *ht, struct clomy_string *key);
+inline char *clomy_strget_char (clomy_ht *ht, struct clomy_string *key);
+inline short *clomy_strget_short (clomy_ht *ht, struct clomy_string *key);
+void *clomy_btget (clomy_ht *ht, const void *key);
+inline int *clomy_btget_int (clomy_ht *ht, const void *key);
+inline float *clomy_btget_float (clomy_ht *ht, const void *key);
+inline long *clomy_btget_long (clomy_ht *ht, const void *key);
+inline double *clomy_btget_double (clomy_ht *ht, const void *key);
+inline char *clomy_btget_char (clomy_ht *ht, const void *key);
+inline short *clomy_btget_short (clomy_ht *ht, const void *key);
+/**/
+
+/* Get values for N KEYS into OUT, NULL for missing keys. The buckets of
+   CLOMY_HASHTABLE_BATCH keys are prefetched before any of them is looked
+   up, so their cache misses overlap. */
+void clomy_htget_batch (clomy_ht *ht, const int *keys, size_t n,
+                                void **out);
+void clomy_u64get_batch (clomy_ht *ht, const U64 *keys, size_t n,
+                                void **out);
+void clomy_s64get_batch (clomy_ht *ht, const S64 *keys, size_t n,
+                                void **out);
+void clomy_stget_batch (clomy_ht *ht, char *const *keys, size_t n,
+                                void **out);
+void clomy_strget_batch (clomy_ht *ht, struct clomy_string *const *keys, size_t n,
+                                void **out);
+void clomy_btget_batch (clomy_ht *ht, const void *const *keys, size_t n,
+                                void **out);
+/**/
 
-void *clomy_stget (clomy_ht *st, char *key);
-inline int *clomy_stget_int (clomy_ht *st, char *key);
-inline float *clomy_stget_float (clomy_ht *st, char *key);
-inline long *clomy_stget_long (clomy_ht *st, char *key);
-inline double *clomy_stget_double (clomy_ht *st, char *key);
-inline char *clomy_stget_char (clomy_ht *st, char *key);
-inline short *clomy_stget_short (clomy_ht *st, char *key);
+/* Put N KEYS with the N values at VALUES, each the table's data size.
+   Prefetches like get_batch. */
+int clomy_htput_batch (clomy_ht *ht, const int *keys, size_t n,
+                               const void *values);
+int clomy_u64put_batch (clomy_ht *ht, const U64 *keys, size_t n,
+                               const void *values);
+int clomy_s64put_batch (clomy_ht *ht, const S64 *keys, size_t n,
+                               const void *values);
+int clomy_stput_batch (clomy_ht *ht, char *const *keys, size_t n,
+                               const void *values);
+int clomy_strput_batch (clomy_ht *ht, struct clomy_string *const *keys, size_t n,
+                               const void *values);
+int clomy_btput_batch (clomy_ht *ht, const void *const *keys, size_t n,
+                               const void *values);
 /**/
 
 /* Delete from hash table. */
 void clomy_htdel (clomy_ht *ht, int key);
+void clomy_u64del (clomy_ht *ht, U64 key);
+void clomy_s64del (clomy_ht *ht, S64 key);
 void clomy_stdel (clomy_ht *ht, char *key);
+void clomy_strdel (clomy_ht *ht, struct clomy_string *key);
+void clomy_btdel (clomy_ht *ht, const void *key);
+/**/
+
+/* Pin the entries of a CLOMY_HTCONCURRENT table until clomy_htleave, so
+   pointers from get and upsert stay valid. Calls nest. */
+void clomy_htenter (clomy_ht *ht);
+void clomy_htleave (clomy_ht *ht);
 
 /* Free the hash table. */
 void clomy_htfold (clomy_ht *ht);
+void clomy_u64fold (clomy_ht *ht);
+void clomy_s64fold (clomy_ht *ht);
 void clomy_stfold (clomy_ht *ht);
+void clomy_strfold (clomy_ht *ht);
+void clomy_btfold (clomy_ht *ht);
+/**/
 
 /*--------------------[ String ]--------------------*/
 
 typedef struct clomy_string
 {
   clomy_arena *ar;
-  size_t size; /* Size of string excluding NULL. */
-  char *data;  /* NULL-terminated string. */
+  size_t size;   /* Size of string excluding NULL. */
+  char *data; /* NULL-terminated string. */
 } clomy_string;
 
 /* New string. */
@@ -483,10 +1349,26 @@ int clomy_file_delete (const char *file_path);
 
 #define arena clomy_arena
 #define archunk clomy_archunk
+#define arpos clomy_arpos
+#define arstat clomy_arstat
 #define aralloc clomy_aralloc
+#define aralloc_aligned clomy_aralloc_aligned
 #define arfree clomy_arfree
+#define arextend clomy_arextend
+#define arrealloc clomy_arrealloc
+#define armark clomy_armark
+#define arrewind clomy_arrewind
+#define arstats clomy_arstats
+#define ardump clomy_ardump
+#define arreset clomy_arreset
 #define arfold clomy_arfold
 
+#define pool clomy_pool
+#define poolinit clomy_poolinit
+#define poolalloc clomy_poolalloc
+#define poolfree clomy_poolfree
+#define poolfold clomy_poolfold
+
 #define da clomy_da
 #define dainit clomy_dainit
 #define daget clomy_daget
@@ -536,6 +1418,12 @@ int clomy_file_delete (const char *file_path);
 /**/
 
 #define dadel clomy_dadel
+#define dadel_range clomy_dadel_range
+#define dainsert_range clomy_dainsert_range
+#define daappend_n clomy_daappend_n
+#define dareserve clomy_dareserve
+#define daresize clomy_daresize
+#define datake clomy_datake
 #define dapop clomy_dapop
 #define dapop_int clomy_dapop_int
 #define dapop_float clomy_dapop_float
@@ -544,11 +1432,114 @@ int clomy_file_delete (const char *file_path);
 #define dapop_char clomy_dapop_char
 #define dapop_short clomy_dapop_short
 #define dafold clomy_dafold
+#define DA_DECLARE CLOMY_DA_DECLARE
+#define da_int clomy_da_int
+#define da_int_init clomy_da_int_init
+#define da_int_reserve clomy_da_int_reserve
+#define da_int_resize clomy_da_int_resize
+#define da_int_append clomy_da_int_append
+#define da_int_append_n clomy_da_int_append_n
+#define da_int_insert clomy_da_int_insert
+#define da_int_del clomy_da_int_del
+#define da_int_fold clomy_da_int_fold
+#define da_float clomy_da_float
+#define da_float_init clomy_da_float_init
+#define da_float_reserve clomy_da_float_reserve
+#define da_float_resize clomy_da_float_resize
+#define da_float_append clomy_da_float_append
+#define da_float_append_n clomy_da_float_append_n
+#define da_float_insert clomy_da_float_insert
+#define da_float_del clomy_da_float_del
+#define da_float_fold clomy_da_float_fold
+#define da_long clomy_da_long
+#define da_long_init clomy_da_long_init
+#define da_long_reserve clomy_da_long_reserve
+#define da_long_resize clomy_da_long_resize
+#define da_long_append clomy_da_long_append
+#define da_long_append_n clomy_da_long_append_n
+#define da_long_insert clomy_da_long_insert
+#define da_long_del clomy_da_long_del
+#define da_long_fold clomy_da_long_fold
+#define da_double clomy_da_double
+#define da_double_init clomy_da_double_init
+#define da_double_reserve clomy_da_double_reserve
+#define da_double_resize clomy_da_double_resize
+#define da_double_append clomy_da_double_append
+#define da_double_append_n clomy_da_double_append_n
+#define da_double_insert clomy_da_double_insert
+#define da_double_del clomy_da_double_del
+#define da_double_fold clomy_da_double_fold
+#define da_char clomy_da_char
+#define da_char_init clomy_da_char_init
+#define da_char_reserve clomy_da_char_reserve
+#define da_char_resize clomy_da_char_resize
+#define da_char_append clomy_da_char_append
+#define da_char_append_n clomy_da_char_append_n
+#define da_char_insert clomy_da_char_insert
+#define da_char_del clomy_da_char_del
+#define da_char_fold clomy_da_char_fold
+#define da_short clomy_da_short
+#define da_short_init clomy_da_short_init
+#define da_short_reserve clomy_da_short_reserve
+#define da_short_resize clomy_da_short_resize
+#define da_short_append clomy_da_short_append
+#define da_short_append_n clomy_da_short_append_n
+#define da_short_insert clomy_da_short_insert
+#define da_short_del clomy_da_short_del
+#define da_short_fold clomy_da_short_fold
+/**/
+#define da_int_sum clomy_da_int_sum
+#define da_int_min clomy_da_int_min
+#define da_int_max clomy_da_int_max
+#define da_int_dot clomy_da_int_dot
+#define da_int_scale clomy_da_int_scale
+#define da_int_add clomy_da_int_add
+#define da_int_prefix_sum clomy_da_int_prefix_sum
+#define da_int_count clomy_da_int_count
+#define da_float_sum clomy_da_float_sum
+#define da_float_min clomy_da_float_min
+#define da_float_max clomy_da_float_max
+#define da_float_dot clomy_da_float_dot
+#define da_float_scale clomy_da_float_scale
+#define da_float_add clomy_da_float_add
+#define da_float_prefix_sum clomy_da_float_prefix_sum
+#define da_float_count clomy_da_float_count
+#define da_long_sum clomy_da_long_sum
+#define da_long_min clomy_da_long_min
+#define da_long_max clomy_da_long_max
+#define da_long_dot clomy_da_long_dot
+#define da_long_scale clomy_da_long_scale
+#define da_long_add clomy_da_long_add
+#define da_long_prefix_sum clomy_da_long_prefix_sum
+#define da_long_count clomy_da_long_count
+#define da_double_sum clomy_da_double_sum
+#define da_double_min clomy_da_double_min
+#define da_double_max clomy_da_double_max
+#define da_double_dot clomy_da_double_dot
+#define da_double_scale clomy_da_double_scale
+#define da_double_add clomy_da_double_add
+#define da_double_prefix_sum clomy_da_double_prefix_sum
+#define da_double_count clomy_da_double_count
+#define da_short_sum clomy_da_short_sum
+#define da_short_min clomy_da_short_min
+#define da_short_max clomy_da_short_max
+#define da_short_dot clomy_da_short_dot
+#define da_short_scale clomy_da_short_scale
+#define da_short_add clomy_da_short_add
+#define da_short_prefix_sum clomy_da_short_prefix_sum
+#define da_short_count clomy_da_short_count
+/**/
 
 #define ht clomy_ht
 #define htdata clomy_htdata
 #define htinit clomy_htinit
+#define hashint clomy_hashint
+#define hashbytes clomy_hashbytes
+#define btinit clomy_btinit
+#define htenter clomy_htenter
+#define htleave clomy_htleave
 #define ht_foreach clomy_ht_foreach
+#define st_foreach clomy_st_foreach
 #define htput clomy_htput
 #define htput_int clomy_htput_int
 #define htput_float clomy_htput_float
@@ -565,10 +1556,56 @@ int clomy_file_delete (const char *file_path);
 #define htget_char clomy_htget_char
 #define htget_short clomy_htget_short
 /**/
+#define htget_batch clomy_htget_batch
+#define htput_batch clomy_htput_batch
+#define htupsert clomy_htupsert
 #define htinc_int clomy_htinc_int
 #define htdel clomy_htdel
 #define htfold clomy_htfold
-#define st_foreach clomy_st_foreach
+#define u64put clomy_u64put
+#define u64put_int clomy_u64put_int
+#define u64put_float clomy_u64put_float
+#define u64put_long clomy_u64put_long
+#define u64put_double clomy_u64put_double
+#define u64put_char clomy_u64put_char
+#define u64put_short clomy_u64put_short
+/**/
+#define u64get clomy_u64get
+#define u64get_int clomy_u64get_int
+#define u64get_float clomy_u64get_float
+#define u64get_long clomy_u64get_long
+#define u64get_double clomy_u64get_double
+#define u64get_char clomy_u64get_char
+#define u64get_short clomy_u64get_short
+/**/
+#define u64get_batch clomy_u64get_batch
+#define u64put_batch clomy_u64put_batch
+#define u64upsert clomy_u64upsert
+#define u64inc_int clomy_u64inc_int
+#define u64del clomy_u64del
+#define u64fold clomy_u64fold
+#define s64put clomy_s64put
+#define s64put_int clomy_s64put_int
+#define s64put_float clomy_s64put_float
+#define s64put_long clomy_s64put_long
+#define s64put_double clomy_s64put_double
+#define s64put_char clomy_s64put_char
+#define s64put_short clomy_s64put_short
+/**/
+#define s64get clomy_s64get
+#define s64get_int clomy_s64get_int
+#define s64get_float clomy_s64get_float
+#define s64get_long clomy_s64get_long
+#define s64get_double clomy_s64get_double
+#define s64get_char clomy_s64get_char
+#define s64get_short clomy_s64get_short
+/**/
+#define s64get_batch clomy_s64get_batch
+#define s64put_batch clomy_s64put_batch
+#define s64upsert clomy_s64upsert
+#define s64inc_int clomy_s64inc_int
+#define s64del clomy_s64del
+#define s64fold clomy_s64fold
 #define stput clomy_stput
 #define stput_int clomy_stput_int
 #define stput_float clomy_stput_float
@@ -585,9 +1622,56 @@ int clomy_file_delete (const char *file_path);
 #define stget_char clomy_stget_char
 #define stget_short clomy_stget_short
 /**/
+#define stget_batch clomy_stget_batch
+#define stput_batch clomy_stput_batch
+#define stupsert clomy_stupsert
 #define stinc_int clomy_stinc_int
 #define stdel clomy_stdel
 #define stfold clomy_stfold
+#define strput clomy_strput
+#define strput_int clomy_strput_int
+#define strput_float clomy_strput_float
+#define strput_long clomy_strput_long
+#define strput_double clomy_strput_double
+#define strput_char clomy_strput_char
+#define strput_short clomy_strput_short
+/**/
+#define strget clomy_strget
+#define strget_int clomy_strget_int
+#define strget_float clomy_strget_float
+#define strget_long clomy_strget_long
+#define strget_double clomy_strget_double
+#define strget_char clomy_strget_char
+#define strget_short clomy_strget_short
+/**/
+#define strget_batch clomy_strget_batch
+#define strput_batch clomy_strput_batch
+#define strupsert clomy_strupsert
+#define strinc_int clomy_strinc_int
+#define strdel clomy_strdel
+#define strfold clomy_strfold
+#define btput clomy_btput
+#define btput_int clomy_btput_int
+#define btput_float clomy_btput_float
+#define btput_long clomy_btput_long
+#define btput_double clomy_btput_double
+#define btput_char clomy_btput_char
+#define btput_short clomy_btput_short
+/**/
+#define btget clomy_btget
+#define btget_int clomy_btget_int
+#define btget_float clomy_btget_float
+#define btget_long clomy_btget_long
+#define btget_double clomy_btget_double
+#define btget_char clomy_btget_char
+#define btget_short clomy_btget_short
+/**/
+#define btget_batch clomy_btget_batch
+#define btput_batch clomy_btput_batch
+#define btupsert clomy_btupsert
+#define btinc_int clomy_btinc_int
+#define btdel clomy_btdel
+#define btfold clomy_btfold
 #define string clomy_string
 #define stringnew clomy_stringnew
 #define stringcpy clomy_stringcpy
@@ -619,955 +1703,5271 @@ int clomy_file_delete (const char *file_path);
 
 #define CLOMY_ALIGN_UP(n, a) (((n) + ((a) - 1)) & ~((a) - 1))
 
-#ifdef CLOMY_IMPLEMENTATION
+#define CLOMY_ARHDR_SIZE CLOMY_ALIGN_UP (sizeof (clomy_aralloc_hdr), 8)
+#define CLOMY_ARMIN_BLOCK                                                     \
+  CLOMY_ALIGN_UP (sizeof (clomy_arfree_block) + sizeof (size_t), 8)
 
-clomy_archunk *
-_clomy_newarchunk (size_t size)
-{
-  size_t cnksize = sizeof (clomy_archunk) + size;
-  clomy_archunk *cnk;
+#ifdef CLOMY_IMPLEMENTATION
 
-#if defined(_WIN32)
-  cnk = HeapAlloc (CLOMY__heap ? CLOMY__heap
-                               : (CLOMY__heap = GetProcessHeap ()),
-                   HEAP_ZERO_MEMORY, cnksize);
-#elif defined(_POSIX_VERSION)
-  cnk = mmap (NULL, cnksize, PROT_READ | PROT_WRITE,
-              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-
-  if (cnk == MAP_FAILED)
-    return NULL;
+#if defined(CLOMY_THREADS)
+static _Atomic (U64) CLOMY__arid;
+static _Thread_local char CLOMY__thread; /* Its address names the thread. */
+static _Thread_local U64 CLOMY__tlsid;
+static _Thread_local clomy_arena *CLOMY__tlsheap;
+static _Thread_local U64 CLOMY__htrid;
+static _Thread_local clomy_htreader *CLOMY__htreader;
+
+/* Atomic access to the links of CLOMY_HTCONCURRENT tables. */
+#define CLOMY__HTLOAD(p)                                                      \
+  atomic_load_explicit ((_Atomic (void *) *)&(p), memory_order_acquire)
+#define CLOMY__HTSTORE(p, v)                                                  \
+  atomic_store_explicit ((_Atomic (void *) *)&(p), (v), memory_order_release)
+#define CLOMY__HTSIZE(ht, n)                                                  \
+  atomic_fetch_add ((_Atomic (size_t) *)&(ht)->size, (size_t)(n))
+#endif /* defined(CLOMY_THREADS) */
+
+#if defined(__GNUC__)
+#define CLOMY__PREFETCH(p) __builtin_prefetch (p)
 #else
-  cnk = (clomy_archunk *)malloc (cnksize);
-#endif /* defined(CLOMY_BACKEND_WINAPI) */
-
-  if (!cnk)
-    return NULL;
+#define CLOMY__PREFETCH(p) ((void)(p))
+#endif /* defined(__GNUC__) */
+
+/* Clones of the numeric kernels, picked through an ifunc at load time. The
+   kernels are plain loops left to the compiler to vectorize for each clone.
+   AVX-512F has no byte and word lanes, x86-64-v4 adds AVX-512BW for char
+   and short. SSE2 is the default of x86-64. */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)            \
+    && !defined(CLOMY_NO_DISPATCH)
+#define CLOMY__SIMD                                                           \
+  __attribute__ ((                                                            \
+      target_clones ("arch=x86-64-v4", "avx512f", "avx2", "default")))
+#else
+#define CLOMY__SIMD
+#endif /* !defined(CLOMY_NO_DISPATCH) */
 
-  cnk->size = 0;
-  cnk->capacity = size;
-  cnk->next = NULL;
-  cnk->free_list = NULL;
+/* Independent accumulators of the reductions. Without them floating point
+   sums could not be reordered into vector lanes. */
+#define CLOMY__LANES 16
 
-  return cnk;
+U32
+_clomy_log2 (U64 x)
+{
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll (x);
+#else
+  U32 n = 0;
+  while (x >>= 1)
+    ++n;
+  return n;
+#endif /* defined(__GNUC__) */
 }
 
-clomy_arfree_block *
-_clomy_find_free_block (clomy_archunk *cnk, size_t needed_size,
-                        clomy_arfree_block **prev_ptr)
+U32
+_clomy_ctz (U64 x)
 {
-  clomy_arfree_block *prev = NULL;
-  clomy_arfree_block *current = cnk->free_list;
-
-  while (current)
+#if defined(__GNUC__)
+  return __builtin_ctzll (x);
+#else
+  U32 n = 0;
+  while (!(x & 1))
     {
-      if (current->size >= needed_size)
-        {
-          if (prev_ptr)
-            *prev_ptr = prev;
-          return current;
-        }
-      prev = current;
-      current = current->next;
+      x >>= 1;
+      ++n;
     }
-
-  if (prev_ptr)
-    *prev_ptr = NULL;
-  return NULL;
-}
-
-void
-_clomy_remove_free_block (clomy_archunk *cnk, clomy_arfree_block *block,
-                          clomy_arfree_block *prev)
-{
-  if (prev)
-    prev->next = block->next;
-  else
-    cnk->free_list = block->next;
+  return n;
+#endif /* defined(__GNUC__) */
 }
 
+#if defined(CLOMY__MMAP)
 void
-_clomy_add_free_block (clomy_archunk *cnk, clomy_arfree_block *new_block)
+_clomy_aradvise (clomy_arena *ar, void *ptr, size_t size)
 {
-  clomy_arfree_block *prev = NULL;
-  clomy_arfree_block *current = cnk->free_list;
+  size_t page, i;
 
-  while (current && current < new_block)
-    {
-      prev = current;
-      current = current->next;
-    }
+#if defined(MADV_HUGEPAGE)
+  if (ar->flags & CLOMY_ARHUGEPAGE)
+    madvise (ptr, size, MADV_HUGEPAGE);
+#endif /* defined(MADV_HUGEPAGE) */
 
-  new_block->next = current;
-  if (prev)
-    prev->next = new_block;
-  else
-    cnk->free_list = new_block;
+  if (!(ar->flags & CLOMY_ARPOPULATE))
+    return;
 
-  if (current && ((char *)new_block + new_block->size) == (char *)current)
-    {
-      new_block->size += current->size;
-      new_block->next = current->next;
-    }
+#if defined(MADV_POPULATE_WRITE)
+  if (madvise (ptr, size, MADV_POPULATE_WRITE) == 0)
+    return;
+#endif /* defined(MADV_POPULATE_WRITE) */
 
-  if (prev && ((char *)prev + prev->size) == (char *)new_block)
-    {
-      prev->size += new_block->size;
-      prev->next = new_block->next;
-    }
+  /* Older kernels: touch every page. */
+  page = (size_t)sysconf (_SC_PAGESIZE);
+  for (i = 0; i < size; i += page)
+    ((volatile U8 *)ptr)[i] = 0;
 }
 
 void *
-clomy_aralloc (clomy_arena *ar, size_t size)
+_clomy_armap (clomy_arena *ar, size_t *size)
 {
-  clomy_archunk *cnk;
-  clomy_aralloc_hdr *hdr;
-  clomy_arfree_block *free_blk, *prev_free, *rem;
-  size_t cnk_size;
-  const size_t hdr_size = CLOMY_ALIGN_UP (sizeof (clomy_aralloc_hdr), 8);
-
-  size = CLOMY_ALIGN_UP (size, 8);
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void *ptr;
 
-  /* Initialize arena */
-  if (!ar->head)
+#if defined(MAP_HUGETLB)
+  /* Explicit huge pages need a pool set up by the admin, try them first. */
+  if ((ar->flags & CLOMY_ARHUGEPAGE) && *size >= CLOMY_HUGEPAGE_SIZE)
     {
-      ar->head = _clomy_newarchunk (CLOMY_ARENA_CAPACITY);
-      if (!ar->head)
-        return NULL;
+      ptr = mmap (NULL, CLOMY_ALIGN_UP (*size, CLOMY_HUGEPAGE_SIZE),
+                  PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED)
+        {
+          *size = CLOMY_ALIGN_UP (*size, CLOMY_HUGEPAGE_SIZE);
+          if (ar->flags & CLOMY_ARPOPULATE)
+            _clomy_aradvise (ar, ptr, *size);
 
-      ar->tail = ar->head;
+          return ptr;
+        }
     }
+#endif /* defined(MAP_HUGETLB) */
 
-  /* Trying first-fit exising chunk. */
-  cnk = ar->head;
-  cnk_size = size + hdr_size;
-  cnk_size = CLOMY_ALIGN_UP (cnk_size, 8);
+  /* Transparent huge pages must be asked for before the pages are faulted
+     in, so MAP_POPULATE only serves plain chunks. */
+#if defined(MAP_POPULATE)
+  if ((ar->flags & (CLOMY_ARPOPULATE | CLOMY_ARHUGEPAGE)) == CLOMY_ARPOPULATE)
+    flags |= MAP_POPULATE;
+#endif /* defined(MAP_POPULATE) */
 
-  while (cnk)
-    {
-      free_blk = _clomy_find_free_block (cnk, cnk_size, &prev_free);
-      if (free_blk)
-        {
-          _clomy_remove_free_block (cnk, free_blk, prev_free);
+  ptr = mmap (NULL, *size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (ptr == MAP_FAILED)
+    return NULL;
 
-          if (free_blk->size >= cnk_size + sizeof (clomy_arfree_block))
-            {
-              rem = (clomy_arfree_block *)((char *)free_blk + cnk_size);
-              rem->size = free_blk->size - cnk_size;
-              _clomy_add_free_block (cnk, rem);
-            }
+#if defined(MAP_POPULATE)
+  if (flags & MAP_POPULATE)
+    return ptr;
+#endif /* defined(MAP_POPULATE) */
 
-          hdr = (clomy_aralloc_hdr *)free_blk;
-          hdr->cnk = cnk;
-          hdr->size = size;
-          hdr->magic = CLOMY_ALLOC_MAGIC;
+  _clomy_aradvise (ar, ptr, *size);
+  return ptr;
+}
 
-          return (void *)((char *)hdr + hdr_size);
-        }
+void *
+_clomy_arcommit (clomy_arena *ar, size_t *size)
+{
+  size_t page = (size_t)sysconf (_SC_PAGESIZE), len;
+  U8 *base;
 
-      if (cnk->capacity - cnk->size >= cnk_size)
-        {
-          hdr = (clomy_aralloc_hdr *)(cnk->data + cnk->size);
-          hdr->cnk = cnk;
-          hdr->size = size;
-          hdr->magic = CLOMY_ALLOC_MAGIC;
+  if (!ar->rsv)
+    {
+      /* Over-reserve by a huge page to align the range on one. */
+      ar->reserve = CLOMY_ALIGN_UP (ar->reserve, CLOMY_HUGEPAGE_SIZE);
+      base = mmap (NULL, ar->reserve + CLOMY_HUGEPAGE_SIZE, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (base == MAP_FAILED)
+        return NULL;
 
-          cnk->size += cnk_size;
-          return (void *)((char *)hdr + hdr_size);
-        }
+      ar->rsv = (U8 *)CLOMY_ALIGN_UP ((size_t)base, CLOMY_HUGEPAGE_SIZE);
+      if (ar->rsv > base)
+        munmap (base, ar->rsv - base);
 
-      cnk = cnk->next;
+      munmap (ar->rsv + ar->reserve, base + CLOMY_HUGEPAGE_SIZE - ar->rsv);
+      ar->rsvused = 0;
     }
 
-  /* Allocate new memory. */
-  cnk_size = cnk_size > CLOMY_ARENA_CAPACITY ? cnk_size : CLOMY_ARENA_CAPACITY;
-  cnk = _clomy_newarchunk (cnk_size);
-  if (!cnk)
+  len = CLOMY_ALIGN_UP (*size, page);
+  if (ar->reserve - ar->rsvused < len)
     return NULL;
 
-  cnk->size = cnk_size;
-
-  ar->tail->next = cnk;
-  ar->tail = cnk;
+  base = ar->rsv + ar->rsvused;
+  if (mprotect (base, len, PROT_READ | PROT_WRITE))
+    return NULL;
 
-  hdr = (clomy_aralloc_hdr *)cnk->data;
-  hdr->cnk = cnk;
-  hdr->size = size;
-  hdr->magic = CLOMY_ALLOC_MAGIC;
+  ar->rsvused += len;
+  *size = len;
+  _clomy_aradvise (ar, base, len);
 
-  return (void *)((char *)hdr + hdr_size);
+  return base;
 }
 
 void
-clomy_arfree (void *value)
+_clomy_ardecommit (void *ptr, size_t size)
 {
-  clomy_archunk *cnk;
-  clomy_aralloc_hdr *hdr;
-  clomy_arfree_block *blk;
-  const size_t hdr_size = CLOMY_ALIGN_UP (sizeof (clomy_aralloc_hdr), 8);
-
-  if (!value)
+  /* MADV_FREE only drops the pages under memory pressure. */
+#if defined(MADV_FREE)
+  if (madvise (ptr, size, MADV_FREE) == 0)
     return;
+#endif /* defined(MADV_FREE) */
 
-  hdr = (clomy_aralloc_hdr *)((char *)value - hdr_size);
-  if (hdr->magic != CLOMY_ALLOC_MAGIC)
-    return;
+#if defined(MADV_DONTNEED)
+  madvise (ptr, size, MADV_DONTNEED);
+#endif /* defined(MADV_DONTNEED) */
+}
+#endif /* defined(CLOMY__MMAP) */
 
-  cnk = hdr->cnk;
+clomy_archunk *
+_clomy_newarchunk (clomy_arena *ar, size_t size, size_t flags)
+{
+  size_t cnksize = sizeof (clomy_archunk) + size;
+  clomy_archunk *cnk;
 
-  hdr->magic = 0;
+#if defined(_WIN32)
+  cnk = HeapAlloc (CLOMY__heap ? CLOMY__heap : (CLOMY__heap = GetProcessHeap()),
+      HEAP_ZERO_MEMORY, cnksize);
+#elif defined(CLOMY__MMAP)
+  /* Chunks of the reserved range go away with the whole range. */
+  cnk = NULL;
+  if (ar->reserve && !(flags & CLOMY_CNKHUGE)
+      && !(ar->flags & CLOMY_ARSHARED))
+    {
+      cnk = _clomy_arcommit (ar, &cnksize);
+      if (cnk)
+        flags |= CLOMY_CNKRESERVED;
+    }
 
-  blk = (clomy_arfree_block *)hdr;
-  blk->size = hdr->size + hdr_size;
-  blk->next = NULL;
+  if (!cnk)
+    cnk = _clomy_armap (ar, &cnksize);
+#else
+  cnk = (clomy_archunk *)malloc (cnksize);
+#endif /* defined(CLOMY_BACKEND_WINAPI) */
+
+  if (!cnk)
+    return NULL;
+
+  cnk->size = 0;
+  cnk->capacity = cnksize - sizeof (clomy_archunk);
+  cnk->ar = ar;
+  cnk->next = NULL;
+  cnk->prev = NULL;
+  cnk->flags = flags;
+#if defined(CLOMY_THREADS)
+  atomic_init (&cnk->rfree, NULL);
+#endif /* defined(CLOMY_THREADS) */
 
-  _clomy_add_free_block (cnk, blk);
+  return cnk;
 }
 
 void
-clomy_arfold (clomy_arena *ar)
+_clomy_freearchunk (clomy_archunk *cnk)
 {
-  clomy_archunk *cnk = ar->head, *next;
-  while (cnk)
-    {
-      next = cnk->next;
 #if defined(_WIN32)
-      HeapFree (CLOMY__heap ? CLOMY__heap : (CLOMY__heap = GetProcessHeap ()),
-                0, cnk);
-#elif defined(_POSIX_VERSION)
+  HeapFree (CLOMY__heap ? CLOMY__heap : (CLOMY__heap = GetProcessHeap ()), 0,
+            cnk);
+#elif defined(CLOMY__MMAP)
+  /* Reserved chunks only give their pages back, the range stays mapped. */
+  if (cnk->flags & CLOMY_CNKRESERVED)
+    {
+#if defined(MADV_DONTNEED)
+      madvise (cnk, sizeof (clomy_archunk) + cnk->capacity, MADV_DONTNEED);
+#endif /* defined(MADV_DONTNEED) */
+      mprotect (cnk, sizeof (clomy_archunk) + cnk->capacity, PROT_NONE);
+    }
+  else
+    {
       munmap (cnk, sizeof (clomy_archunk) + cnk->capacity);
+    }
 #else
-      free (cnk);
+  free (cnk);
 #endif /* defined(CLOMY_BACKEND_WINAPI) */
-      cnk = next;
-    }
-
-  ar->head = NULL;
-  ar->tail = NULL;
 }
 
-/*----------------------------------------------------------------------*/
-
-int
-clomy_dainit (clomy_da *da, clomy_arena *ar, size_t data_size, size_t capacity)
+size_t
+_clomy_arnextcap (clomy_arena *ar, size_t size)
 {
-  CLOMY_FAILFALSE (ar, "Arena is required.");
+  size_t cap = ar->cnkcap ? ar->cnkcap : CLOMY_ARENA_CAPACITY;
 
-  da->ar = ar;
-  da->data = clomy_aralloc (ar, data_size * capacity);
-  if (!da->data)
+  if (cap < CLOMY_ARENA_MAX_CAPACITY)
+    ar->cnkcap = cap * 2 < CLOMY_ARENA_MAX_CAPACITY ? cap * 2
+                                                    : CLOMY_ARENA_MAX_CAPACITY;
+  else
+    ar->cnkcap = cap;
+
+  return size > cap ? size : cap;
+}
+
+size_t
+_clomy_arbin (size_t size)
+{
+  if (size < CLOMY_ARENA_SMALL_SIZE)
+    return size >> 3;
+
+  return CLOMY_ARENA_SMALL_BINS + _clomy_log2 (size)
+         - _clomy_log2 (CLOMY_ARENA_SMALL_SIZE);
+}
+
+clomy_arfree_block *
+_clomy_find_free_block (clomy_arena *ar, size_t needed_size)
+{
+  clomy_arfree_block *blk;
+  size_t bin = _clomy_arbin (needed_size), w;
+  U64 bits;
+
+  /* Small bins hold exactly one size, large bins a range of sizes. */
+  if (bin < CLOMY_ARENA_SMALL_BINS)
+    {
+      if (ar->bins[bin])
+        return ar->bins[bin];
+    }
+  else
+    {
+      for (blk = ar->bins[bin]; blk; blk = blk->next)
+        if (blk->size >= needed_size)
+          return blk;
+    }
+
+  /* Any block in a bigger bin fits. */
+  ++bin;
+  for (w = bin / 64; w < CLOMY_ARENA_BINS / 64; ++w)
+    {
+      bits = ar->binmap[w];
+      if (w == bin / 64)
+        bits &= ~(U64)0 << (bin % 64);
+
+      if (bits)
+        return ar->bins[w * 64 + _clomy_ctz (bits)];
+    }
+
+  return NULL;
+}
+
+void
+_clomy_remove_free_block (clomy_arena *ar, clomy_arfree_block *block)
+{
+  size_t bin = _clomy_arbin (block->size);
+
+  CLOMY__ARCOUNT (ar, free, -block->size);
+
+  if (block->prev)
+    block->prev->next = block->next;
+  else
+    ar->bins[bin] = block->next;
+
+  if (block->next)
+    block->next->prev = block->prev;
+
+  if (!ar->bins[bin])
+    ar->binmap[bin / 64] &= ~((U64)1 << (bin % 64));
+}
+
+void
+_clomy_add_free_block (clomy_archunk *cnk, clomy_arfree_block *new_block)
+{
+  clomy_arena *ar = cnk->ar;
+  clomy_arfree_block *blk;
+  char *end = (char *)cnk->data + cnk->size, *next;
+  size_t bin;
+
+  next = (char *)new_block + new_block->size;
+
+  /* Coalesce with the following block. */
+  if (next < end && ((clomy_arfree_block *)next)->magic == CLOMY_FREE_MAGIC)
+    {
+      blk = (clomy_arfree_block *)next;
+      _clomy_remove_free_block (ar, blk);
+      new_block->size += blk->size;
+      next += blk->size;
+    }
+
+  /* Coalesce with the preceding block, found through its footer. */
+  if (new_block->flags & CLOMY_ARPREV_FREE)
+    {
+      blk = (clomy_arfree_block *)((char *)new_block
+                                   - *((size_t *)new_block - 1));
+      _clomy_remove_free_block (ar, blk);
+      blk->size += new_block->size;
+      new_block = blk;
+    }
+
+  /* Give the block back to the bump frontier of the tail chunk. */
+  if (next == end && cnk == ar->tail)
+    {
+      cnk->size -= new_block->size;
+      return;
+    }
+
+  new_block->cnk = cnk;
+  new_block->magic = CLOMY_FREE_MAGIC;
+  *(size_t *)(next - sizeof (size_t)) = new_block->size;
+
+  if (next < end)
+    ((clomy_aralloc_hdr *)next)->flags |= CLOMY_ARPREV_FREE;
+
+  CLOMY__ARCOUNT (ar, free, new_block->size);
+
+  bin = _clomy_arbin (new_block->size);
+  new_block->prev = NULL;
+  new_block->next = ar->bins[bin];
+  if (new_block->next)
+    new_block->next->prev = new_block;
+
+  ar->bins[bin] = new_block;
+  ar->binmap[bin / 64] |= (U64)1 << (bin % 64);
+}
+
+void *
+_clomy_arbump (clomy_arena *ar, size_t size)
+{
+  clomy_archunk *cnk = ar->tail, *next;
+  void *ptr;
+
+  size = CLOMY_ALIGN_UP (size, 8);
+
+  if (!cnk || cnk->capacity - cnk->size < size)
+    {
+      /* Chunks after the tail are left over from a rewind. */
+      next = cnk ? cnk->next : NULL;
+      if (next && next->capacity >= size)
+        {
+          cnk = next;
+          cnk->size = 0;
+        }
+      else
+        {
+          next = _clomy_newarchunk (ar, _clomy_arnextcap (ar, size), 0);
+          if (!next)
+            return NULL;
+
+          CLOMY__ARCOUNT (ar, new_chunks, 1);
+          if (cnk)
+            {
+              next->next = cnk->next;
+              cnk->next = next;
+            }
+          else
+            {
+              ar->head = next;
+            }
+          cnk = next;
+        }
+
+      ar->tail = cnk;
+    }
+
+  CLOMY__ARCOUNT (ar, allocs, 1);
+  CLOMY__ARCOUNT (ar, in_use, size);
+
+  ptr = cnk->data + cnk->size;
+  cnk->size += size;
+  return ptr;
+}
+
+void
+_clomy_arrelease (clomy_arena *ar, void *value)
+{
+  if (!(ar->flags & CLOMY_ARBUMP))
+    clomy_arfree (value);
+}
+
+#if defined(CLOMY_THREADS)
+clomy_arena *
+_clomy_arheap (clomy_arena *ar)
+{
+  clomy_archunk *cnk;
+  clomy_arena *heap;
+  U64 id = atomic_load (&ar->id), fresh;
+
+  if (!id)
+    {
+      fresh = atomic_fetch_add (&CLOMY__arid, 1) + 1;
+      id = atomic_compare_exchange_strong (&ar->id, &id, fresh) ? fresh : id;
+    }
+
+  if (CLOMY__tlsid == id)
+    return CLOMY__tlsheap;
+
+  for (heap = atomic_load (&ar->heaps); heap; heap = heap->sibling)
+    if (heap->owner == &CLOMY__thread)
+      break;
+
+  if (!heap)
+    {
+      cnk = _clomy_newarchunk (ar, sizeof (clomy_arena), 0);
+      if (!cnk)
+        return NULL;
+
+      heap = (clomy_arena *)cnk->data;
+      memset (heap, 0, sizeof (clomy_arena));
+      heap->flags = ar->flags & ~CLOMY_ARSHARED;
+      heap->retain = ar->retain;
+      heap->highwater = ar->highwater;
+      heap->parent = ar;
+      heap->owner = &CLOMY__thread;
+
+      heap->sibling = atomic_load (&ar->heaps);
+      while (!atomic_compare_exchange_weak (&ar->heaps, &heap->sibling, heap))
+        ;
+    }
+
+  CLOMY__tlsid = id;
+  CLOMY__tlsheap = heap;
+  return heap;
+}
+
+void
+_clomy_ardrain (clomy_arena *heap)
+{
+  clomy_archunk *cnk, *next;
+  clomy_arfree_block *blk, *nblk;
+
+  atomic_exchange_explicit (&heap->remote, 0, memory_order_acquire);
+
+  for (cnk = heap->head; cnk; cnk = next)
+    {
+      next = cnk->next;
+      blk = atomic_exchange_explicit (&cnk->rfree, NULL, memory_order_acquire);
+      for (; blk; blk = nblk)
+        {
+          nblk = blk->next;
+          _clomy_arfreehdr ((clomy_aralloc_hdr *)blk);
+        }
+    }
+
+  for (cnk = heap->huge; cnk; cnk = next)
+    {
+      next = cnk->next;
+      blk = atomic_exchange_explicit (&cnk->rfree, NULL, memory_order_acquire);
+      if (blk)
+        _clomy_arfreehdr ((clomy_aralloc_hdr *)blk);
+    }
+}
+#endif /* defined(CLOMY_THREADS) */
+
+void *
+clomy_aralloc (clomy_arena *ar, size_t size)
+{
+  clomy_archunk *cnk, *old;
+  clomy_aralloc_hdr *hdr;
+  clomy_arfree_block *free_blk, *rem;
+  char *next;
+  size_t blk_size, left;
+
+#if defined(CLOMY_THREADS)
+  if (ar->flags & CLOMY_ARSHARED)
+    {
+      ar = _clomy_arheap (ar);
+      if (!ar)
+        return NULL;
+
+      if (atomic_load_explicit (&ar->remote, memory_order_relaxed))
+        _clomy_ardrain (ar);
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+  if (ar->flags & CLOMY_ARBUMP)
+    return _clomy_arbump (ar, size);
+
+  blk_size = CLOMY_ARHDR_SIZE + CLOMY_ALIGN_UP (size, 8);
+  if (blk_size < CLOMY_ARMIN_BLOCK)
+    blk_size = CLOMY_ARMIN_BLOCK;
+
+  /* Huge allocations bypass the chunks. */
+  if (blk_size >= CLOMY_ARENA_HUGE_SIZE)
+    {
+      cnk = _clomy_newarchunk (ar, blk_size, CLOMY_CNKHUGE);
+      if (!cnk)
+        return NULL;
+
+      CLOMY__ARCOUNT (ar, new_chunks, 1);
+      CLOMY__ARCOUNT (ar, allocs, 1);
+      CLOMY__ARCOUNT (ar, in_use, blk_size);
+
+      cnk->size = blk_size;
+      cnk->next = ar->huge;
+      if (ar->huge)
+        ar->huge->prev = cnk;
+      ar->huge = cnk;
+
+      hdr = (clomy_aralloc_hdr *)cnk->data;
+      hdr->cnk = cnk;
+      hdr->size = blk_size - CLOMY_ARHDR_SIZE;
+      hdr->magic = CLOMY_ALLOC_MAGIC;
+      hdr->flags = 0;
+
+      return (void *)((char *)hdr + CLOMY_ARHDR_SIZE);
+    }
+
+  /* Initialize arena */
+  if (!ar->head)
+    {
+      ar->head = _clomy_newarchunk (ar, _clomy_arnextcap (ar, blk_size), 0);
+      if (!ar->head)
+        return NULL;
+
+      CLOMY__ARCOUNT (ar, new_chunks, 1);
+      ar->tail = ar->head;
+    }
+
+  /* Trying the size-class bins. */
+  free_blk = _clomy_find_free_block (ar, blk_size);
+  if (free_blk)
+    {
+      cnk = free_blk->cnk;
+      _clomy_remove_free_block (ar, free_blk);
+
+      if (free_blk->size >= blk_size + CLOMY_ARMIN_BLOCK)
+        {
+          rem = (clomy_arfree_block *)((char *)free_blk + blk_size);
+          rem->size = free_blk->size - blk_size;
+          rem->flags = 0;
+          _clomy_add_free_block (cnk, rem);
+        }
+      else
+        {
+          blk_size = free_blk->size;
+          next = (char *)free_blk + blk_size;
+          if (next < (char *)cnk->data + cnk->size)
+            ((clomy_aralloc_hdr *)next)->flags &= ~CLOMY_ARPREV_FREE;
+        }
+
+      CLOMY__ARCOUNT (ar, allocs, 1);
+      CLOMY__ARCOUNT (ar, in_use, blk_size);
+
+      hdr = (clomy_aralloc_hdr *)free_blk;
+      hdr->cnk = cnk;
+      hdr->size = blk_size - CLOMY_ARHDR_SIZE;
+      hdr->magic = CLOMY_ALLOC_MAGIC;
+      hdr->flags = 0;
+
+      return (void *)((char *)hdr + CLOMY_ARHDR_SIZE);
+    }
+
+  /* Bump from the tail chunk, opening a new one if it is full. */
+  cnk = ar->tail;
+  if (cnk->capacity - cnk->size < blk_size)
+    {
+      /* Chunks after the tail are kept from a reset. */
+      if (cnk->next && cnk->next->capacity >= blk_size)
+        {
+          cnk = cnk->next;
+        }
+      else
+        {
+          cnk = _clomy_newarchunk (ar, _clomy_arnextcap (ar, blk_size), 0);
+          if (!cnk)
+            return NULL;
+
+          CLOMY__ARCOUNT (ar, new_chunks, 1);
+          cnk->next = ar->tail->next;
+        }
+
+      /* Whatever is left in the old tail goes to the bins. */
+      old = ar->tail;
+      left = old->capacity - old->size;
+      old->next = cnk;
+      ar->tail = cnk;
+
+      if (left >= CLOMY_ARMIN_BLOCK)
+        {
+          rem = (clomy_arfree_block *)(old->data + old->size);
+          rem->size = left;
+          rem->flags = 0;
+          old->size = old->capacity;
+          _clomy_add_free_block (old, rem);
+        }
+    }
+
+  CLOMY__ARCOUNT (ar, allocs, 1);
+  CLOMY__ARCOUNT (ar, in_use, blk_size);
+
+  hdr = (clomy_aralloc_hdr *)(cnk->data + cnk->size);
+  hdr->cnk = cnk;
+  hdr->size = blk_size - CLOMY_ARHDR_SIZE;
+  hdr->magic = CLOMY_ALLOC_MAGIC;
+  hdr->flags = 0;
+
+  cnk->size += blk_size;
+  return (void *)((char *)hdr + CLOMY_ARHDR_SIZE);
+}
+
+void *
+clomy_aralloc_aligned (clomy_arena *ar, size_t size, size_t align)
+{
+  clomy_aralloc_hdr *hdr, *ahdr;
+  clomy_arfree_block *blk;
+  char *ptr, *aligned;
+  size_t gap, slack;
+
+  CLOMY_FAILFALSE (align && !(align & (align - 1)),
+                   "Alignment is not a power of two.");
+
+  if (align <= 8)
+    return clomy_aralloc (ar, size);
+
+#if defined(CLOMY_THREADS)
+  if (ar->flags & CLOMY_ARSHARED)
+    {
+      ar = _clomy_arheap (ar);
+      if (!ar)
+        return NULL;
+
+      if (atomic_load_explicit (&ar->remote, memory_order_relaxed))
+        _clomy_ardrain (ar);
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+  /* Bump past the padding, then give the unused slack back. */
+  if (ar->flags & CLOMY_ARBUMP)
+    {
+      ptr = _clomy_arbump (ar, size + align - 8);
+      if (!ptr)
+        return NULL;
+
+      aligned = (char *)CLOMY_ALIGN_UP ((size_t)ptr, align);
+      slack = CLOMY_ALIGN_UP (size + align - 8, 8) - (aligned - ptr)
+              - CLOMY_ALIGN_UP (size, 8);
+      ar->tail->size -= slack;
+      CLOMY__ARCOUNT (ar, in_use, -slack);
+
+      return aligned;
+    }
+
+  ptr = clomy_aralloc (ar, size + align + CLOMY_ARMIN_BLOCK);
+  if (!ptr)
+    return NULL;
+
+  /* The padding before the aligned header must hold a free block. */
+  aligned = (char *)CLOMY_ALIGN_UP ((size_t)ptr, align);
+  gap = aligned - ptr;
+  while (gap && gap < CLOMY_ARMIN_BLOCK)
+    {
+      aligned += align;
+      gap += align;
+    }
+
+  hdr = (clomy_aralloc_hdr *)(ptr - CLOMY_ARHDR_SIZE);
+  if (gap)
+    {
+      ahdr = (clomy_aralloc_hdr *)(aligned - CLOMY_ARHDR_SIZE);
+      ahdr->cnk = hdr->cnk;
+      ahdr->size = hdr->size - gap;
+      ahdr->magic = CLOMY_ALLOC_MAGIC;
+      ahdr->flags = 0;
+
+      /* Huge chunks hold a single allocation, their padding just idles. */
+      if (hdr->cnk->flags & CLOMY_CNKHUGE)
+        {
+          hdr->magic = 0;
+        }
+      else
+        {
+          blk = (clomy_arfree_block *)hdr;
+          blk->size = gap;
+          blk->flags = 0;
+          CLOMY__ARCOUNT (hdr->cnk->ar, in_use, -gap);
+          _clomy_add_free_block (ahdr->cnk, blk);
+        }
+    }
+
+  /* Trim what is left past the allocation. */
+  clomy_arextend (ar, aligned, 0, size);
+  return aligned;
+}
+
+void
+clomy_arfree (void *value)
+{
+  clomy_aralloc_hdr *hdr;
+#if defined(CLOMY_THREADS)
+  clomy_archunk *cnk;
+  clomy_arfree_block *blk;
+#endif /* defined(CLOMY_THREADS) */
+
+  if (!value)
+    return;
+
+  hdr = (clomy_aralloc_hdr *)((char *)value - CLOMY_ARHDR_SIZE);
+  if (hdr->magic != CLOMY_ALLOC_MAGIC)
+    return;
+
+#if defined(CLOMY_THREADS)
+  /* Memory of another thread's heap is queued on its chunk. The header stays
+     untouched until the owner drains the queue. */
+  cnk = hdr->cnk;
+  if (cnk->ar->parent && cnk->ar->owner != &CLOMY__thread)
+    {
+      blk = (clomy_arfree_block *)hdr;
+      blk->next = atomic_load_explicit (&cnk->rfree, memory_order_relaxed);
+      while (!atomic_compare_exchange_weak_explicit (
+          &cnk->rfree, &blk->next, blk, memory_order_release,
+          memory_order_relaxed))
+        ;
+
+      atomic_fetch_add_explicit (&cnk->ar->remote, 1, memory_order_relaxed);
+      return;
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+  _clomy_arfreehdr (hdr);
+}
+
+void
+_clomy_arfreehdr (clomy_aralloc_hdr *hdr)
+{
+  clomy_archunk *cnk;
+  clomy_arfree_block *blk;
+
+  hdr->magic = 0;
+
+  cnk = hdr->cnk;
+  CLOMY__ARCOUNT (cnk->ar, frees, 1);
+
+  if (cnk->flags & CLOMY_CNKHUGE)
+    {
+      CLOMY__ARCOUNT (cnk->ar, in_use, -cnk->size);
+
+      if (cnk->prev)
+        cnk->prev->next = cnk->next;
+      else
+        cnk->ar->huge = cnk->next;
+
+      if (cnk->next)
+        cnk->next->prev = cnk->prev;
+
+      _clomy_freearchunk (cnk);
+      return;
+    }
+
+  blk = (clomy_arfree_block *)hdr;
+  blk->size = CLOMY_ARHDR_SIZE + hdr->size;
+  CLOMY__ARCOUNT (cnk->ar, in_use, -blk->size);
+
+  _clomy_add_free_block (hdr->cnk, blk);
+}
+
+int
+clomy_arextend (clomy_arena *ar, void *value, size_t old_size, size_t size)
+{
+  clomy_archunk *cnk;
+  clomy_aralloc_hdr *hdr;
+  clomy_arfree_block *blk;
+  char *next, *end;
+  size_t blk_size, cur, lead;
+
+#if defined(CLOMY_THREADS)
+  if (ar->flags & CLOMY_ARSHARED)
+    {
+      ar = _clomy_arheap (ar);
+      if (!ar)
+        return 1;
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+  if (ar->flags & CLOMY_ARBUMP)
+    {
+      cnk = ar->tail;
+      old_size = CLOMY_ALIGN_UP (old_size, 8);
+      size = CLOMY_ALIGN_UP (size, 8);
+
+      /* Only the last allocation can move the bump pointer. */
+      if (!cnk || (char *)value + old_size != (char *)cnk->data + cnk->size)
+        return size > old_size;
+
+      if (size > old_size && cnk->capacity - cnk->size < size - old_size)
+        return 1;
+
+      CLOMY__ARCOUNT (ar, in_use, size - old_size);
+      cnk->size = cnk->size - old_size + size;
+      return 0;
+    }
+
+  hdr = (clomy_aralloc_hdr *)((char *)value - CLOMY_ARHDR_SIZE);
+  if (hdr->magic != CLOMY_ALLOC_MAGIC)
+    return 1;
+
+  cnk = hdr->cnk;
+#if defined(CLOMY_THREADS)
+  /* Only the owner may touch its heap. */
+  if (cnk->ar != ar && cnk->ar->parent)
+    return 1;
+#endif /* defined(CLOMY_THREADS) */
+
+  cur = CLOMY_ARHDR_SIZE + hdr->size;
+  blk_size = CLOMY_ARHDR_SIZE + CLOMY_ALIGN_UP (size, 8);
+  if (blk_size < CLOMY_ARMIN_BLOCK)
+    blk_size = CLOMY_ARMIN_BLOCK;
+
+  next = (char *)hdr + cur;
+  end = (char *)cnk->data + cnk->size;
+
+  if (cnk->flags & CLOMY_CNKHUGE)
+    {
+      /* Aligned allocations don't start at the chunk data. */
+      lead = (char *)hdr - (char *)cnk->data;
+      if (lead + blk_size > cnk->capacity)
+        return 1;
+
+      CLOMY__ARCOUNT (cnk->ar, in_use, lead + blk_size - cnk->size);
+      hdr->size = blk_size - CLOMY_ARHDR_SIZE;
+      cnk->size = lead + blk_size;
+      return 0;
+    }
+
+  if (blk_size > cur)
+    {
+      /* The block sits at the bump frontier. */
+      if (next == end && cnk == cnk->ar->tail)
+        {
+          if (cnk->capacity - cnk->size < blk_size - cur)
+            return 1;
+
+          CLOMY__ARCOUNT (cnk->ar, in_use, blk_size - cur);
+          cnk->size += blk_size - cur;
+          hdr->size = blk_size - CLOMY_ARHDR_SIZE;
+          return 0;
+        }
+
+      /* The block is followed by a big enough free block. */
+      blk = (clomy_arfree_block *)next;
+      if (next == end || blk->magic != CLOMY_FREE_MAGIC
+          || cur + blk->size < blk_size)
+        return 1;
+
+      _clomy_remove_free_block (cnk->ar, blk);
+      CLOMY__ARCOUNT (cnk->ar, in_use, blk->size);
+      cur += blk->size;
+      next = (char *)hdr + cur;
+      if (next < end)
+        ((clomy_aralloc_hdr *)next)->flags &= ~CLOMY_ARPREV_FREE;
+    }
+
+  /* Give back what is left over. */
+  hdr->size = cur - CLOMY_ARHDR_SIZE;
+  if (cur - blk_size >= CLOMY_ARMIN_BLOCK)
+    {
+      blk = (clomy_arfree_block *)((char *)hdr + blk_size);
+      blk->size = cur - blk_size;
+      blk->flags = 0;
+      hdr->size = blk_size - CLOMY_ARHDR_SIZE;
+      CLOMY__ARCOUNT (cnk->ar, in_use, -blk->size);
+      _clomy_add_free_block (cnk, blk);
+    }
+
+  return 0;
+}
+
+void *
+clomy_arrealloc (clomy_arena *ar, void *value, size_t old_size, size_t size)
+{
+  void *ptr;
+
+  if (!value)
+    return clomy_aralloc (ar, size);
+
+  if (clomy_arextend (ar, value, old_size, size) == 0)
+    return value;
+
+  ptr = clomy_aralloc (ar, size);
+  if (!ptr)
+    return NULL;
+
+  memcpy (ptr, value, old_size < size ? old_size : size);
+  _clomy_arrelease (ar, value);
+
+  return ptr;
+}
+
+clomy_arpos
+clomy_armark (clomy_arena *ar)
+{
+  clomy_arpos pos = { NULL, 0 };
+
+#if defined(CLOMY_THREADS)
+  if (ar->flags & CLOMY_ARSHARED)
+    {
+      ar = _clomy_arheap (ar);
+      if (!ar)
+        return pos;
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+  pos.cnk = ar->tail;
+  pos.size = ar->tail ? ar->tail->size : 0;
+  return pos;
+}
+
+void
+clomy_arrewind (clomy_arena *ar, clomy_arpos pos)
+{
+  CLOMY_FAILFALSE (ar->flags & CLOMY_ARBUMP, "Arena is not in bump mode.");
+
+#if defined(CLOMY_THREADS)
+  if (ar->flags & CLOMY_ARSHARED)
+    {
+      ar = _clomy_arheap (ar);
+      if (!ar)
+        return;
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+  if (!pos.cnk)
+    {
+      pos.cnk = ar->head;
+      pos.size = 0;
+    }
+
+  if (!pos.cnk)
+    return;
+
+  pos.cnk->size = pos.size;
+  ar->tail = pos.cnk;
+
+#if defined(CLOMY_ARENA_STATS)
+  ar->stat.in_use = 0;
+  for (pos.cnk = ar->head; pos.cnk != ar->tail; pos.cnk = pos.cnk->next)
+    ar->stat.in_use += pos.cnk->size;
+
+  ar->stat.in_use += ar->tail->size;
+#endif /* defined(CLOMY_ARENA_STATS) */
+}
+
+void
+clomy_arstats (clomy_arena *ar, clomy_arstat *st)
+{
+  clomy_archunk *cnk;
+  clomy_arfree_block *blk;
+  size_t w;
+#if defined(CLOMY_THREADS)
+  clomy_arena *heap;
+  clomy_arstat hst;
+#endif /* defined(CLOMY_THREADS) */
+
+  memset (st, 0, sizeof (clomy_arstat));
+
+#if defined(CLOMY_THREADS)
+  for (heap = atomic_load (&ar->heaps); heap; heap = heap->sibling)
+    {
+      clomy_arstats (heap, &hst);
+      st->chunks += hst.chunks;
+      st->huge_chunks += hst.huge_chunks;
+      st->mapped += hst.mapped;
+      st->huge_mapped += hst.huge_mapped;
+      if (hst.largest_free > st->largest_free)
+        st->largest_free = hst.largest_free;
+
+      st->in_use += hst.in_use;
+      st->free += hst.free;
+      st->allocs += hst.allocs;
+      st->frees += hst.frees;
+      st->new_chunks += hst.new_chunks;
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+#if defined(CLOMY_ARENA_STATS)
+  st->in_use += ar->stat.in_use;
+  st->free += ar->stat.free;
+  st->allocs += ar->stat.allocs;
+  st->frees += ar->stat.frees;
+  st->new_chunks += ar->stat.new_chunks;
+#endif /* defined(CLOMY_ARENA_STATS) */
+
+  /* The largest free block is in the highest non-empty bin. */
+  for (w = CLOMY_ARENA_BINS / 64; w-- > 0;)
+    if (ar->binmap[w])
+      {
+        blk = ar->bins[w * 64 + _clomy_log2 (ar->binmap[w])];
+        for (; blk; blk = blk->next)
+          if (blk->size > st->largest_free)
+            st->largest_free = blk->size;
+
+        break;
+      }
+
+  for (cnk = ar->head; cnk; cnk = cnk->next)
+    {
+      ++st->chunks;
+      st->mapped += sizeof (clomy_archunk) + cnk->capacity;
+    }
+
+  for (cnk = ar->huge; cnk; cnk = cnk->next)
+    {
+      ++st->huge_chunks;
+      st->huge_mapped += sizeof (clomy_archunk) + cnk->capacity;
+    }
+}
+
+void
+clomy_arreset (clomy_arena *ar)
+{
+  clomy_archunk *cnk, *next, *last = NULL;
+  size_t kept = 0, touched = 0, rsvend = 0;
+#if defined(CLOMY__MMAP)
+  size_t page = (size_t)sysconf (_SC_PAGESIZE), from;
+  U8 *start, *end;
+#endif /* defined(CLOMY__MMAP) */
+#if defined(CLOMY_THREADS)
+  clomy_arena *heap;
+
+  /* Each heap keeps chunks within the budget of the shared arena. */
+  for (heap = atomic_load (&ar->heaps); heap; heap = heap->sibling)
+    {
+      heap->retain = ar->retain;
+      heap->highwater = ar->highwater;
+      clomy_arreset (heap);
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+  /* Huge allocations never outlive the round. */
+  for (cnk = ar->huge; cnk; cnk = next)
+    {
+      next = cnk->next;
+      _clomy_freearchunk (cnk);
+    }
+
+  ar->huge = NULL;
+
+  /* Keep the oldest chunks that fit in the retain budget. */
+  for (cnk = ar->head; cnk; cnk = next)
+    {
+      next = cnk->next;
+      kept += sizeof (clomy_archunk) + cnk->capacity;
+      if (kept > ar->retain)
+        {
+          _clomy_freearchunk (cnk);
+          continue;
+        }
+
+#if defined(CLOMY__MMAP)
+      /* Pages touched past the high-water mark go back lazily. */
+      if (ar->highwater && touched + cnk->size > ar->highwater)
+        {
+          from = ar->highwater > touched ? ar->highwater - touched : 0;
+          start = (U8 *)CLOMY_ALIGN_UP ((size_t)cnk->data + from, page);
+          end = (U8 *)CLOMY_ALIGN_UP ((size_t)cnk->data + cnk->size, page);
+          if (end > start)
+            _clomy_ardecommit (start, end - start);
+        }
+#endif /* defined(CLOMY__MMAP) */
+
+      touched += cnk->size;
+      cnk->size = 0;
+      last = cnk;
+#if defined(CLOMY_THREADS)
+      /* Queued frees point into the blocks just dropped. */
+      atomic_exchange (&cnk->rfree, NULL);
+#endif /* defined(CLOMY_THREADS) */
+
+      /* Chunks grown after a reset are linked in behind the head, so the
+         list isn't in address order: commit past the highest kept one. */
+      if (cnk->flags & CLOMY_CNKRESERVED
+          && (size_t)((U8 *)cnk->data + cnk->capacity - ar->rsv) > rsvend)
+        rsvend = (U8 *)cnk->data + cnk->capacity - ar->rsv;
+    }
+
+  if (last)
+    last->next = NULL;
+
+  ar->rsvused = rsvend;
+
+  ar->head = last ? ar->head : NULL;
+  ar->tail = ar->head;
+  memset (ar->bins, 0, sizeof (ar->bins));
+  memset (ar->binmap, 0, sizeof (ar->binmap));
+#if defined(CLOMY_THREADS)
+  atomic_store (&ar->remote, 0);
+#endif /* defined(CLOMY_THREADS) */
+#if defined(CLOMY_ARENA_STATS)
+  ar->stat.in_use = 0;
+  ar->stat.free = 0;
+#endif /* defined(CLOMY_ARENA_STATS) */
+}
+
+void
+clomy_arfold (clomy_arena *ar)
+{
+  clomy_archunk *cnk = ar->head, *next;
+#if defined(CLOMY_THREADS)
+  clomy_arena *heap, *sibling;
+
+  for (heap = atomic_load (&ar->heaps); heap; heap = sibling)
+    {
+      sibling = heap->sibling;
+      clomy_arfold (heap);
+      _clomy_freearchunk (
+          (clomy_archunk *)((char *)heap - offsetof (clomy_archunk, data)));
+    }
+
+  /* A new id invalidates the heaps cached by threads. */
+  atomic_store (&ar->heaps, NULL);
+  atomic_store (&ar->id, 0);
+#endif /* defined(CLOMY_THREADS) */
+
+  /* Reserved chunks go away with the reserved range. */
+  while (cnk)
+    {
+      next = cnk->next;
+      if (!(cnk->flags & CLOMY_CNKRESERVED))
+        _clomy_freearchunk (cnk);
+
+      cnk = next;
+    }
+
+  for (cnk = ar->huge; cnk; cnk = next)
+    {
+      next = cnk->next;
+      _clomy_freearchunk (cnk);
+    }
+
+#if defined(CLOMY__MMAP)
+  if (ar->rsv)
+    munmap (ar->rsv, ar->reserve);
+#endif /* defined(CLOMY__MMAP) */
+
+  ar->rsv = NULL;
+  ar->rsvused = 0;
+  ar->head = NULL;
+  ar->tail = NULL;
+  ar->huge = NULL;
+  ar->cnkcap = 0;
+  memset (ar->bins, 0, sizeof (ar->bins));
+  memset (ar->binmap, 0, sizeof (ar->binmap));
+#if defined(CLOMY_ARENA_STATS)
+  memset (&ar->stat, 0, sizeof (ar->stat));
+#endif /* defined(CLOMY_ARENA_STATS) */
+}
+
+#if defined(CLOMY_ARENA_STATS)
+void
+clomy_ardump (clomy_arena *ar, FILE *out)
+{
+  clomy_archunk *cnk;
+  clomy_aralloc_hdr *hdr;
+  clomy_arstat st;
+  size_t hist[64], i, n = 0, used, nfree, freed, largest, blk_size;
+  char *p;
+#if defined(CLOMY_THREADS)
+  clomy_arena *heap;
+
+  for (heap = atomic_load (&ar->heaps); heap; heap = heap->sibling)
+    clomy_ardump (heap, out);
+#endif /* defined(CLOMY_THREADS) */
+
+  clomy_arstats (ar, &st);
+  fprintf (out,
+           "arena %p: %zu chunks, %zu bytes mapped, %zu in use, %zu free, "
+           "largest free %zu\n",
+           (void *)ar, st.chunks, st.mapped, st.in_use, st.free,
+           st.largest_free);
+  fprintf (out,
+           "  %zu allocs, %zu frees, %zu new chunks, %zu huge chunks of %zu "
+           "bytes\n",
+           st.allocs, st.frees, st.new_chunks, st.huge_chunks,
+           st.huge_mapped);
+
+  for (cnk = ar->head; cnk; cnk = cnk->next, ++n)
+    {
+      fprintf (out, "  chunk %zu: %zu/%zu bytes", n, cnk->size,
+               cnk->capacity);
+
+      /* Bump chunks have no headers to walk. */
+      if (ar->flags & CLOMY_ARBUMP)
+        {
+          fputc ('\n', out);
+          continue;
+        }
+
+      /* Blocks tile the chunk up to its bump frontier. */
+      memset (hist, 0, sizeof (hist));
+      used = nfree = freed = largest = 0;
+      for (p = (char *)cnk->data; p < (char *)cnk->data + cnk->size;
+           p += blk_size)
+        {
+          hdr = (clomy_aralloc_hdr *)p;
+          if (hdr->magic == CLOMY_FREE_MAGIC)
+            {
+              blk_size = ((clomy_arfree_block *)p)->size;
+              freed += blk_size;
+              if (blk_size > largest)
+                largest = blk_size;
+
+              ++nfree;
+              ++hist[_clomy_log2 (blk_size)];
+            }
+          else
+            {
+              blk_size = CLOMY_ARHDR_SIZE + hdr->size;
+              used += blk_size;
+            }
+        }
+
+      fprintf (out, ", %zu in use, %zu free in %zu blocks, largest %zu\n",
+               used, freed, nfree, largest);
+
+      for (i = 0; i < 64; ++i)
+        if (hist[i])
+          fprintf (out, "    %zu-%zu: %zu\n", (size_t)1 << i,
+                   ((size_t)2 << i) - 1, hist[i]);
+    }
+}
+#endif /* defined(CLOMY_ARENA_STATS) */
+
+/*----------------------------------------------------------------------*/
+
+int
+clomy_poolinit (clomy_pool *pl, clomy_arena *ar, size_t size)
+{
+  CLOMY_FAILFALSE (ar, "Arena is required.");
+
+  pl->ar = ar;
+  pl->size = CLOMY_ALIGN_UP (size < sizeof (void *) ? sizeof (void *) : size,
+                             8);
+  pl->slabcap = CLOMY_POOL_CAPACITY;
+  pl->free = NULL;
+  pl->cur = NULL;
+  pl->end = NULL;
+  pl->slabs = NULL;
+
+  return 0;
+}
+
+void *
+clomy_poolalloc (clomy_pool *pl)
+{
+  void *obj = pl->free;
+  size_t cap;
+  U8 *slab;
+
+  if (obj)
+    {
+      pl->free = *(void **)obj;
+      return obj;
+    }
+
+  if ((size_t)(pl->end - pl->cur) < pl->size)
+    {
+      cap = pl->slabcap;
+      if (cap < pl->size)
+        cap = pl->size;
+
+      slab = clomy_aralloc (pl->ar, sizeof (void *) + cap);
+      if (!slab)
+        return NULL;
+
+      if (pl->slabcap < CLOMY_POOL_MAX_CAPACITY)
+        pl->slabcap *= 2;
+
+      *(void **)slab = pl->slabs;
+      pl->slabs = slab;
+      pl->cur = slab + sizeof (void *);
+      pl->end = pl->cur + cap;
+    }
+
+  obj = pl->cur;
+  pl->cur += pl->size;
+  return obj;
+}
+
+void
+clomy_poolfree (clomy_pool *pl, void *value)
+{
+  if (!value)
+    return;
+
+  *(void **)value = pl->free;
+  pl->free = value;
+}
+
+void
+clomy_poolfold (clomy_pool *pl)
+{
+  void *slab, *next;
+
+  for (slab = pl->slabs; slab; slab = next)
+    {
+      next = *(void **)slab;
+      _clomy_arrelease (pl->ar, slab);
+    }
+
+  pl->slabcap = CLOMY_POOL_CAPACITY;
+  pl->free = NULL;
+  pl->cur = NULL;
+  pl->end = NULL;
+  pl->slabs = NULL;
+}
+
+/*----------------------------------------------------------------------*/
+
+int
+clomy_dainit (clomy_da *da, clomy_arena *ar, size_t data_size, size_t capacity)
+{
+  CLOMY_FAILFALSE (ar, "Arena is required.");
+
+  if (da->flags & CLOMY_DARING)
+    {
+      /* Power of two capacity lets slots be found with a mask. */
+      capacity = capacity < 8 ? 8 : capacity;
+      capacity = (size_t)1 << (_clomy_log2 (capacity - 1) + 1);
+    }
+  else
+    capacity = CLOMY_ALIGN_UP (capacity, 8);
+
+  da->ar = ar;
+  da->data = clomy_aralloc (ar, data_size * capacity);
+  if (!da->data)
+    return 1;
+
+  da->data_size = data_size;
+  da->size = 0;
+  da->capacity = capacity;
+  da->head = 0;
+
+  return 0;
+}
+
+int
+clomy_dacap (clomy_da *da, size_t capacity)
+{
+  void *newarr;
+  size_t n;
+
+  if (da->flags & CLOMY_DARING)
+    {
+      CLOMY_FAILFALSE (capacity >= da->size && !(capacity & (capacity - 1)),
+                       "Ring capacity is not a power of two.");
+
+      newarr = da->ar ? clomy_aralloc (da->ar, capacity * da->data_size)
+                      : malloc (capacity * da->data_size);
+      if (!newarr)
+        return 1;
+
+      /* Copy the elements unwrapped, to the start of the new array. */
+      n = da->capacity - da->head < da->size ? da->capacity - da->head
+                                              : da->size;
+      memcpy (newarr, clomy_daget (da, 0), n * da->data_size);
+      memcpy ((char *)newarr + n * da->data_size, da->data,
+              (da->size - n) * da->data_size);
+
+      if (da->ar)
+        _clomy_arrelease (da->ar, da->data);
+      else
+        free (da->data);
+
+      da->data = newarr;
+      da->capacity = capacity;
+      da->head = 0;
+
+      return 0;
+    }
+
+  if (da->ar)
+    {
+      newarr = clomy_arrealloc (da->ar, da->data, da->capacity * da->data_size,
+                                capacity * da->data_size);
+    }
+  else
+    {
+      newarr = realloc (da->data, capacity * da->data_size);
+    }
+
+  if (!newarr)
+    return 1;
+
+  da->data = newarr;
+  da->capacity = capacity;
+
+  return 0;
+}
+
+void *
+clomy_daget (clomy_da *da, size_t i)
+{
+  if (da->flags & CLOMY_DARING)
+    i = (da->head + i) & (da->capacity - 1);
+
+  return (char *)da->data + i * da->data_size;
+}
+
+int clomy_daget_int (clomy_da *da, size_t i) {
+  return *(int *) clomy_daget (da, i);
+}
+float clomy_daget_float (clomy_da *da, size_t i) {
+  return *(float *) clomy_daget (da, i);
+}
+long clomy_daget_long (clomy_da *da, size_t i) {
+  return *(long *) clomy_daget (da, i);
+}
+double clomy_daget_double (clomy_da *da, size_t i) {
+  return *(double *) clomy_daget (da, i);
+}
+char clomy_daget_char (clomy_da *da, size_t i) {
+  return *(char *) clomy_daget (da, i);
+}
+short clomy_daget_short (clomy_da *da, size_t i) {
+  return *(short *) clomy_daget (da, i);
+}
+/**/
+
+void *
+clomy_dafirst (clomy_da *da)
+{
+  return clomy_daget(da, 0);
+}
+
+int clomy_dafirst_int (clomy_da *da) {
+  return *(int *) clomy_daget (da, 0);
+}
+float clomy_dafirst_float (clomy_da *da) {
+  return *(float *) clomy_daget (da, 0);
+}
+long clomy_dafirst_long (clomy_da *da) {
+  return *(long *) clomy_daget (da, 0);
+}
+double clomy_dafirst_double (clomy_da *da) {
+  return *(double *) clomy_daget (da, 0);
+}
+char clomy_dafirst_char (clomy_da *da) {
+  return *(char *) clomy_daget (da, 0);
+}
+short clomy_dafirst_short (clomy_da *da) {
+  return *(short *) clomy_daget (da, 0);
+}
+/**/
+
+void *
+clomy_dalast (clomy_da *da)
+{
+  return clomy_daget(da, da->size - 1);
+}
+
+int clomy_dalast_int (clomy_da *da) {
+  return *(int *) clomy_daget (da, da->size - 1);
+}
+float clomy_dalast_float (clomy_da *da) {
+  return *(float *) clomy_daget (da, da->size - 1);
+}
+long clomy_dalast_long (clomy_da *da) {
+  return *(long *) clomy_daget (da, da->size - 1);
+}
+double clomy_dalast_double (clomy_da *da) {
+  return *(double *) clomy_daget (da, da->size - 1);
+}
+char clomy_dalast_char (clomy_da *da) {
+  return *(char *) clomy_daget (da, da->size - 1);
+}
+short clomy_dalast_short (clomy_da *da) {
+  return *(short *) clomy_daget (da, da->size - 1);
+}
+/**/
+
+int
+clomy_dagrow (clomy_da *da)
+{
+  return clomy_dareserve (da, da->size + 1);
+}
+
+int
+clomy_dareserve (clomy_da *da, size_t capacity)
+{
+  size_t cap = da->capacity ? da->capacity : 8;
+
+  if (capacity <= da->capacity)
+    return 0;
+
+  /* Doubling keeps ring capacities a power of two. */
+  while (cap < capacity)
+    cap *= 2;
+
+  return clomy_dacap (da, cap);
+}
+
+int
+clomy_daresize (clomy_da *da, size_t size)
+{
+  if (size > da->size)
+    {
+      if (clomy_dareserve (da, size))
+        return 1;
+
+      _clomy_daput (da, da->size, NULL, size - da->size);
+    }
+
+  da->size = size;
+  return 0;
+}
+
+void
+_clomy_daput (clomy_da *da, size_t i, const void *data, size_t n)
+{
+  size_t m = n;
+
+  /* A ring range may wrap around the end of data, then it takes two
+     copies. */
+  if (da->flags & CLOMY_DARING)
+    {
+      i = (da->head + i) & (da->capacity - 1);
+      m = da->capacity - i < n ? da->capacity - i : n;
+    }
+
+  if (data)
+    {
+      memcpy ((char *)da->data + i * da->data_size, data, m * da->data_size);
+      memcpy (da->data, (const char *)data + m * da->data_size,
+              (n - m) * da->data_size);
+    }
+  else
+    {
+      memset ((char *)da->data + i * da->data_size, 0, m * da->data_size);
+      memset (da->data, 0, (n - m) * da->data_size);
+    }
+}
+
+int
+clomy_daappend (clomy_da *da, void *data)
+{
+  if (clomy_dagrow (da))
+    return 1;
+
+  memcpy (clomy_daget (da, da->size), data, da->data_size);
+  ++da->size;
+
+  return 0;
+}
+
+int clomy_daappend_int (clomy_da *da, int data) {
+  return clomy_daappend(da, &data);
+}
+int clomy_daappend_float (clomy_da *da, float data) {
+  return clomy_daappend(da, &data);
+}
+int clomy_daappend_long (clomy_da *da, long data) {
+  return clomy_daappend(da, &data);
+}
+int clomy_daappend_double (clomy_da *da, double data) {
+  return clomy_daappend(da, &data);
+}
+int clomy_daappend_char (clomy_da *da, char data) {
+  return clomy_daappend(da, &data);
+}
+int clomy_daappend_short (clomy_da *da, short data) {
+  return clomy_daappend(da, &data);
+}
+/**/
+
+int
+clomy_daappend_n (clomy_da *da, const void *data, size_t n)
+{
+  if (clomy_dareserve (da, da->size + n))
+    return 1;
+
+  _clomy_daput (da, da->size, data, n);
+  da->size += n;
+
+  return 0;
+}
+
+int
+clomy_dapush (clomy_da *da, void *data)
+{
+  if (da->flags & CLOMY_DARING)
+    return clomy_dainsert (da, 0, data);
+
+  if (clomy_dagrow (da))
+    return 1;
+
+  memmove ((char *)da->data + da->data_size, da->data,
+           da->size * da->data_size);
+  memcpy ((char *)da->data, data, da->data_size);
+  ++da->size;
+
+  return 0;
+}
+
+int clomy_dapush_int (clomy_da *da, int data) {
+  return clomy_dapush (da, &(int){ data });
+}
+int clomy_dapush_float (clomy_da *da, float data) {
+  return clomy_dapush (da, &(float){ data });
+}
+int clomy_dapush_long (clomy_da *da, long data) {
+  return clomy_dapush (da, &(long){ data });
+}
+int clomy_dapush_double (clomy_da *da, double data) {
+  return clomy_dapush (da, &(double){ data });
+}
+int clomy_dapush_char (clomy_da *da, char data) {
+  return clomy_dapush (da, &(char){ data });
+}
+int clomy_dapush_short (clomy_da *da, short data) {
+  return clomy_dapush (da, &(short){ data });
+}
+/**/
+
+int
+clomy_dainsert (clomy_da *da, size_t i, void *data)
+{
+  return clomy_dainsert_range (da, i, data, 1);
+}
+
+int clomy_dainsert_int (clomy_da *da, size_t i, int data) {
+  return clomy_dainsert (da, i, &(int){ data });
+}
+int clomy_dainsert_float (clomy_da *da, size_t i, float data) {
+  return clomy_dainsert (da, i, &(float){ data });
+}
+int clomy_dainsert_long (clomy_da *da, size_t i, long data) {
+  return clomy_dainsert (da, i, &(long){ data });
+}
+int clomy_dainsert_double (clomy_da *da, size_t i, double data) {
+  return clomy_dainsert (da, i, &(double){ data });
+}
+int clomy_dainsert_char (clomy_da *da, size_t i, char data) {
+  return clomy_dainsert (da, i, &(char){ data });
+}
+int clomy_dainsert_short (clomy_da *da, size_t i, short data) {
+  return clomy_dainsert (da, i, &(short){ data });
+}
+/**/
+
+int
+clomy_dainsert_range (clomy_da *da, size_t i, const void *data, size_t n)
+{
+  char *pos;
+  size_t j;
+
+  if (i > da->size)
+    return 1;
+
+  if (clomy_dareserve (da, da->size + n))
+    return 1;
+
+  /* Rings make room on the shorter side of I. */
+  if (da->flags & CLOMY_DARING)
+    {
+      if (2 * i <= da->size)
+        {
+          da->head = (da->head - n) & (da->capacity - 1);
+          for (j = 0; j < i; ++j)
+            memcpy (clomy_daget (da, j), clomy_daget (da, j + n),
+                    da->data_size);
+        }
+      else
+        for (j = da->size; j > i; --j)
+          memcpy (clomy_daget (da, j + n - 1), clomy_daget (da, j - 1),
+                  da->data_size);
+    }
+  else
+    {
+      pos = (char *)da->data + i * da->data_size;
+      memmove (pos + n * da->data_size, pos, (da->size - i) * da->data_size);
+    }
+
+  _clomy_daput (da, i, data, n);
+  da->size += n;
+
+  return 0;
+}
+
+void
+clomy_dadel (clomy_da *da, size_t i)
+{
+  clomy_dadel_range (da, i, 1);
+}
+
+void
+clomy_dadel_range (clomy_da *da, size_t i, size_t n)
+{
+  char *pos;
+  size_t j;
+
+  if (i >= da->size)
+    return;
+
+  n = n < da->size - i ? n : da->size - i;
+
+  /* Rings close the gap from the shorter side of I. */
+  if (da->flags & CLOMY_DARING)
+    {
+      if (i < da->size - i - n)
+        {
+          for (j = i; j > 0; --j)
+            memcpy (clomy_daget (da, j + n - 1), clomy_daget (da, j - 1),
+                    da->data_size);
+
+          da->head = (da->head + n) & (da->capacity - 1);
+        }
+      else
+        for (j = i; j + n < da->size; ++j)
+          memcpy (clomy_daget (da, j), clomy_daget (da, j + n),
+                  da->data_size);
+    }
+  else
+    {
+      pos = (char *)da->data + i * da->data_size;
+      memmove (pos, pos + n * da->data_size,
+               (da->size - i - n) * da->data_size);
+    }
+
+  da->size -= n;
+}
+
+int
+clomy_datake (clomy_da *da, void *out)
+{
+  if (!da->size)
+    return 1;
+
+  if (out)
+    memcpy (out, clomy_daget (da, 0), da->data_size);
+
+  clomy_dadel (da, 0);
+  return 0;
+}
+
+void *
+clomy_dapop (clomy_da *da)
+{
+  void *data;
+
+  if (!da->size)
+    return NULL;
+
+  data = clomy_aralloc (da->ar, da->data_size);
+  if (data)
+    clomy_datake (da, data);
+
+  return data;
+}
+
+int clomy_dapop_int (clomy_da *da) {
+  int data = 0;
+  clomy_datake (da, &data);
+  return data;
+}
+float clomy_dapop_float (clomy_da *da) {
+  float data = 0;
+  clomy_datake (da, &data);
+  return data;
+}
+long clomy_dapop_long (clomy_da *da) {
+  long data = 0;
+  clomy_datake (da, &data);
+  return data;
+}
+double clomy_dapop_double (clomy_da *da) {
+  double data = 0;
+  clomy_datake (da, &data);
+  return data;
+}
+char clomy_dapop_char (clomy_da *da) {
+  char data = 0;
+  clomy_datake (da, &data);
+  return data;
+}
+short clomy_dapop_short (clomy_da *da) {
+  short data = 0;
+  clomy_datake (da, &data);
+  return data;
+}
+/**/
+
+void
+clomy_dafold (clomy_da *da)
+{
+  if (da->data)
+    {
+      _clomy_arrelease (da->ar, da->data);
+      da->data = NULL;
+    }
+}
+
+void *
+_clomy_tdagrow (clomy_arena *ar, void *data, size_t *capacity, size_t elem,
+                size_t size)
+{
+  size_t cap = *capacity ? *capacity : 8;
+
+  while (cap < size)
+    cap *= 2;
+
+  data = clomy_arrealloc (ar, data, *capacity * elem, cap * elem);
+  if (data)
+    *capacity = cap;
+
+  return data;
+}
+
+CLOMY__SIMD int
+clomy_da_int_sum (clomy_da_int *da)
+{
+  const int *d = da->data;
+  unsigned int acc[CLOMY__LANES] = { 0 }, sum = 0;
+  size_t i, j;
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += (unsigned int)d[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    sum += acc[j];
+
+  for (; i < da->size; ++i)
+    sum += (unsigned int)d[i];
+
+  return (int)sum;
+}
+
+CLOMY__SIMD int
+clomy_da_int_min (clomy_da_int *da)
+{
+  const int *d = da->data;
+  int acc[CLOMY__LANES], min;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] < acc[j] ? d[i + j] : acc[j];
+
+  min = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    min = acc[j] < min ? acc[j] : min;
+
+  for (; i < da->size; ++i)
+    min = d[i] < min ? d[i] : min;
+
+  return min;
+}
+
+CLOMY__SIMD int
+clomy_da_int_max (clomy_da_int *da)
+{
+  const int *d = da->data;
+  int acc[CLOMY__LANES], max;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] > acc[j] ? d[i + j] : acc[j];
+
+  max = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    max = acc[j] > max ? acc[j] : max;
+
+  for (; i < da->size; ++i)
+    max = d[i] > max ? d[i] : max;
+
+  return max;
+}
+
+CLOMY__SIMD int
+clomy_da_int_dot (clomy_da_int *a, clomy_da_int *b)
+{
+  const int *x = a->data, *y = b->data;
+  unsigned int acc[CLOMY__LANES] = { 0 }, dot = 0;
+  size_t i, j;
+
+  CLOMY_FAILFALSE (a->size == b->size, "Arrays differ in size.");
+
+  for (i = 0; i + CLOMY__LANES <= a->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += (unsigned int)x[i + j] * (unsigned int)y[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    dot += acc[j];
+
+  for (; i < a->size; ++i)
+    dot += (unsigned int)x[i] * (unsigned int)y[i];
+
+  return (int)dot;
+}
+
+CLOMY__SIMD void
+clomy_da_int_scale (clomy_da_int *da, int k)
+{
+  int *d = da->data;
+  size_t i;
+
+  for (i = 0; i < da->size; ++i)
+    d[i] = (int)((unsigned int)d[i] * (unsigned int)k);
+}
+
+CLOMY__SIMD void
+clomy_da_int_add (clomy_da_int *dst, clomy_da_int *src)
+{
+  int *d = dst->data;
+  const int *s = src->data;
+  size_t i;
+
+  CLOMY_FAILFALSE (dst->size == src->size, "Arrays differ in size.");
+
+  for (i = 0; i < dst->size; ++i)
+    d[i] = (int)((unsigned int)d[i] + (unsigned int)s[i]);
+}
+
+CLOMY__SIMD void
+clomy_da_int_prefix_sum (clomy_da_int *da)
+{
+  int *d = da->data;
+  size_t i;
+
+  /* Each sum needs the previous one, only the loads and stores widen. */
+  for (i = 1; i < da->size; ++i)
+    d[i] = (int)((unsigned int)d[i] + (unsigned int)d[i - 1]);
+}
+
+CLOMY__SIMD size_t
+clomy_da_int_count (clomy_da_int *da, int cmp, int value)
+{
+  const int *d = da->data;
+  int lt = !!(cmp & CLOMY_CMPLT);
+  int eq = !!(cmp & CLOMY_CMPEQ);
+  int gt = !!(cmp & CLOMY_CMPGT);
+  int acc[CLOMY__LANES] = { 0 };
+  size_t i, j, n = 0;
+
+  /* Count in T to keep the lanes as wide as the elements, flushing before
+     a short could overflow. */
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    {
+      for (j = 0; j < CLOMY__LANES; ++j)
+        acc[j] += (d[i + j] < value) * lt + (d[i + j] == value) * eq
+                  + (d[i + j] > value) * gt;
+
+      if ((i / CLOMY__LANES) % 4096 == 4095)
+        for (j = 0; j < CLOMY__LANES; ++j)
+          {
+            n += (size_t)acc[j];
+            acc[j] = 0;
+          }
+    }
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    n += (size_t)acc[j];
+
+  for (; i < da->size; ++i)
+    n += (d[i] < value && lt) || (d[i] == value && eq) || (d[i] > value && gt);
+
+  return n;
+}
+CLOMY__SIMD float
+clomy_da_float_sum (clomy_da_float *da)
+{
+  const float *d = da->data;
+  float acc[CLOMY__LANES] = { 0 }, sum = 0;
+  size_t i, j;
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += d[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    sum += acc[j];
+
+  for (; i < da->size; ++i)
+    sum += d[i];
+
+  return sum;
+}
+
+CLOMY__SIMD float
+clomy_da_float_min (clomy_da_float *da)
+{
+  const float *d = da->data;
+  float acc[CLOMY__LANES], min;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] < acc[j] ? d[i + j] : acc[j];
+
+  min = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    min = acc[j] < min ? acc[j] : min;
+
+  for (; i < da->size; ++i)
+    min = d[i] < min ? d[i] : min;
+
+  return min;
+}
+
+CLOMY__SIMD float
+clomy_da_float_max (clomy_da_float *da)
+{
+  const float *d = da->data;
+  float acc[CLOMY__LANES], max;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] > acc[j] ? d[i + j] : acc[j];
+
+  max = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    max = acc[j] > max ? acc[j] : max;
+
+  for (; i < da->size; ++i)
+    max = d[i] > max ? d[i] : max;
+
+  return max;
+}
+
+CLOMY__SIMD float
+clomy_da_float_dot (clomy_da_float *a, clomy_da_float *b)
+{
+  const float *x = a->data, *y = b->data;
+  float acc[CLOMY__LANES] = { 0 }, dot = 0;
+  size_t i, j;
+
+  CLOMY_FAILFALSE (a->size == b->size, "Arrays differ in size.");
+
+  for (i = 0; i + CLOMY__LANES <= a->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += x[i + j] * y[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    dot += acc[j];
+
+  for (; i < a->size; ++i)
+    dot += x[i] * y[i];
+
+  return dot;
+}
+
+CLOMY__SIMD void
+clomy_da_float_scale (clomy_da_float *da, float k)
+{
+  float *d = da->data;
+  size_t i;
+
+  for (i = 0; i < da->size; ++i)
+    d[i] *= k;
+}
+
+CLOMY__SIMD void
+clomy_da_float_add (clomy_da_float *dst, clomy_da_float *src)
+{
+  float *d = dst->data;
+  const float *s = src->data;
+  size_t i;
+
+  CLOMY_FAILFALSE (dst->size == src->size, "Arrays differ in size.");
+
+  for (i = 0; i < dst->size; ++i)
+    d[i] += s[i];
+}
+
+CLOMY__SIMD void
+clomy_da_float_prefix_sum (clomy_da_float *da)
+{
+  float *d = da->data;
+  size_t i;
+
+  /* Each sum needs the previous one, only the loads and stores widen. */
+  for (i = 1; i < da->size; ++i)
+    d[i] += d[i - 1];
+}
+
+CLOMY__SIMD size_t
+clomy_da_float_count (clomy_da_float *da, int cmp, float value)
+{
+  const float *d = da->data;
+  float lt = !!(cmp & CLOMY_CMPLT);
+  float eq = !!(cmp & CLOMY_CMPEQ);
+  float gt = !!(cmp & CLOMY_CMPGT);
+  float acc[CLOMY__LANES] = { 0 };
+  size_t i, j, n = 0;
+
+  /* Count in T to keep the lanes as wide as the elements, flushing before
+     a short could overflow. */
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    {
+      for (j = 0; j < CLOMY__LANES; ++j)
+        acc[j] += (d[i + j] < value) * lt + (d[i + j] == value) * eq
+                  + (d[i + j] > value) * gt;
+
+      if ((i / CLOMY__LANES) % 4096 == 4095)
+        for (j = 0; j < CLOMY__LANES; ++j)
+          {
+            n += (size_t)acc[j];
+            acc[j] = 0;
+          }
+    }
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    n += (size_t)acc[j];
+
+  for (; i < da->size; ++i)
+    n += (d[i] < value && lt) || (d[i] == value && eq) || (d[i] > value && gt);
+
+  return n;
+}
+CLOMY__SIMD long
+clomy_da_long_sum (clomy_da_long *da)
+{
+  const long *d = da->data;
+  unsigned long acc[CLOMY__LANES] = { 0 }, sum = 0;
+  size_t i, j;
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += (unsigned long)d[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    sum += acc[j];
+
+  for (; i < da->size; ++i)
+    sum += (unsigned long)d[i];
+
+  return (long)sum;
+}
+
+CLOMY__SIMD long
+clomy_da_long_min (clomy_da_long *da)
+{
+  const long *d = da->data;
+  long acc[CLOMY__LANES], min;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] < acc[j] ? d[i + j] : acc[j];
+
+  min = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    min = acc[j] < min ? acc[j] : min;
+
+  for (; i < da->size; ++i)
+    min = d[i] < min ? d[i] : min;
+
+  return min;
+}
+
+CLOMY__SIMD long
+clomy_da_long_max (clomy_da_long *da)
+{
+  const long *d = da->data;
+  long acc[CLOMY__LANES], max;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] > acc[j] ? d[i + j] : acc[j];
+
+  max = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    max = acc[j] > max ? acc[j] : max;
+
+  for (; i < da->size; ++i)
+    max = d[i] > max ? d[i] : max;
+
+  return max;
+}
+
+CLOMY__SIMD long
+clomy_da_long_dot (clomy_da_long *a, clomy_da_long *b)
+{
+  const long *x = a->data, *y = b->data;
+  unsigned long acc[CLOMY__LANES] = { 0 }, dot = 0;
+  size_t i, j;
+
+  CLOMY_FAILFALSE (a->size == b->size, "Arrays differ in size.");
+
+  for (i = 0; i + CLOMY__LANES <= a->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += (unsigned long)x[i + j] * (unsigned long)y[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    dot += acc[j];
+
+  for (; i < a->size; ++i)
+    dot += (unsigned long)x[i] * (unsigned long)y[i];
+
+  return (long)dot;
+}
+
+CLOMY__SIMD void
+clomy_da_long_scale (clomy_da_long *da, long k)
+{
+  long *d = da->data;
+  size_t i;
+
+  for (i = 0; i < da->size; ++i)
+    d[i] = (long)((unsigned long)d[i] * (unsigned long)k);
+}
+
+CLOMY__SIMD void
+clomy_da_long_add (clomy_da_long *dst, clomy_da_long *src)
+{
+  long *d = dst->data;
+  const long *s = src->data;
+  size_t i;
+
+  CLOMY_FAILFALSE (dst->size == src->size, "Arrays differ in size.");
+
+  for (i = 0; i < dst->size; ++i)
+    d[i] = (long)((unsigned long)d[i] + (unsigned long)s[i]);
+}
+
+CLOMY__SIMD void
+clomy_da_long_prefix_sum (clomy_da_long *da)
+{
+  long *d = da->data;
+  size_t i;
+
+  /* Each sum needs the previous one, only the loads and stores widen. */
+  for (i = 1; i < da->size; ++i)
+    d[i] = (long)((unsigned long)d[i] + (unsigned long)d[i - 1]);
+}
+
+CLOMY__SIMD size_t
+clomy_da_long_count (clomy_da_long *da, int cmp, long value)
+{
+  const long *d = da->data;
+  long lt = !!(cmp & CLOMY_CMPLT);
+  long eq = !!(cmp & CLOMY_CMPEQ);
+  long gt = !!(cmp & CLOMY_CMPGT);
+  long acc[CLOMY__LANES] = { 0 };
+  size_t i, j, n = 0;
+
+  /* Count in T to keep the lanes as wide as the elements, flushing before
+     a short could overflow. */
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    {
+      for (j = 0; j < CLOMY__LANES; ++j)
+        acc[j] += (d[i + j] < value) * lt + (d[i + j] == value) * eq
+                  + (d[i + j] > value) * gt;
+
+      if ((i / CLOMY__LANES) % 4096 == 4095)
+        for (j = 0; j < CLOMY__LANES; ++j)
+          {
+            n += (size_t)acc[j];
+            acc[j] = 0;
+          }
+    }
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    n += (size_t)acc[j];
+
+  for (; i < da->size; ++i)
+    n += (d[i] < value && lt) || (d[i] == value && eq) || (d[i] > value && gt);
+
+  return n;
+}
+CLOMY__SIMD double
+clomy_da_double_sum (clomy_da_double *da)
+{
+  const double *d = da->data;
+  double acc[CLOMY__LANES] = { 0 }, sum = 0;
+  size_t i, j;
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += d[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    sum += acc[j];
+
+  for (; i < da->size; ++i)
+    sum += d[i];
+
+  return sum;
+}
+
+CLOMY__SIMD double
+clomy_da_double_min (clomy_da_double *da)
+{
+  const double *d = da->data;
+  double acc[CLOMY__LANES], min;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] < acc[j] ? d[i + j] : acc[j];
+
+  min = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    min = acc[j] < min ? acc[j] : min;
+
+  for (; i < da->size; ++i)
+    min = d[i] < min ? d[i] : min;
+
+  return min;
+}
+
+CLOMY__SIMD double
+clomy_da_double_max (clomy_da_double *da)
+{
+  const double *d = da->data;
+  double acc[CLOMY__LANES], max;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] > acc[j] ? d[i + j] : acc[j];
+
+  max = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    max = acc[j] > max ? acc[j] : max;
+
+  for (; i < da->size; ++i)
+    max = d[i] > max ? d[i] : max;
+
+  return max;
+}
+
+CLOMY__SIMD double
+clomy_da_double_dot (clomy_da_double *a, clomy_da_double *b)
+{
+  const double *x = a->data, *y = b->data;
+  double acc[CLOMY__LANES] = { 0 }, dot = 0;
+  size_t i, j;
+
+  CLOMY_FAILFALSE (a->size == b->size, "Arrays differ in size.");
+
+  for (i = 0; i + CLOMY__LANES <= a->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += x[i + j] * y[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    dot += acc[j];
+
+  for (; i < a->size; ++i)
+    dot += x[i] * y[i];
+
+  return dot;
+}
+
+CLOMY__SIMD void
+clomy_da_double_scale (clomy_da_double *da, double k)
+{
+  double *d = da->data;
+  size_t i;
+
+  for (i = 0; i < da->size; ++i)
+    d[i] *= k;
+}
+
+CLOMY__SIMD void
+clomy_da_double_add (clomy_da_double *dst, clomy_da_double *src)
+{
+  double *d = dst->data;
+  const double *s = src->data;
+  size_t i;
+
+  CLOMY_FAILFALSE (dst->size == src->size, "Arrays differ in size.");
+
+  for (i = 0; i < dst->size; ++i)
+    d[i] += s[i];
+}
+
+CLOMY__SIMD void
+clomy_da_double_prefix_sum (clomy_da_double *da)
+{
+  double *d = da->data;
+  size_t i;
+
+  /* Each sum needs the previous one, only the loads and stores widen. */
+  for (i = 1; i < da->size; ++i)
+    d[i] += d[i - 1];
+}
+
+CLOMY__SIMD size_t
+clomy_da_double_count (clomy_da_double *da, int cmp, double value)
+{
+  const double *d = da->data;
+  double lt = !!(cmp & CLOMY_CMPLT);
+  double eq = !!(cmp & CLOMY_CMPEQ);
+  double gt = !!(cmp & CLOMY_CMPGT);
+  double acc[CLOMY__LANES] = { 0 };
+  size_t i, j, n = 0;
+
+  /* Count in T to keep the lanes as wide as the elements, flushing before
+     a short could overflow. */
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    {
+      for (j = 0; j < CLOMY__LANES; ++j)
+        acc[j] += (d[i + j] < value) * lt + (d[i + j] == value) * eq
+                  + (d[i + j] > value) * gt;
+
+      if ((i / CLOMY__LANES) % 4096 == 4095)
+        for (j = 0; j < CLOMY__LANES; ++j)
+          {
+            n += (size_t)acc[j];
+            acc[j] = 0;
+          }
+    }
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    n += (size_t)acc[j];
+
+  for (; i < da->size; ++i)
+    n += (d[i] < value && lt) || (d[i] == value && eq) || (d[i] > value && gt);
+
+  return n;
+}
+CLOMY__SIMD short
+clomy_da_short_sum (clomy_da_short *da)
+{
+  const short *d = da->data;
+  short acc[CLOMY__LANES] = { 0 }, sum = 0;
+  size_t i, j;
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += d[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    sum += acc[j];
+
+  for (; i < da->size; ++i)
+    sum += d[i];
+
+  return sum;
+}
+
+CLOMY__SIMD short
+clomy_da_short_min (clomy_da_short *da)
+{
+  const short *d = da->data;
+  short acc[CLOMY__LANES], min;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] < acc[j] ? d[i + j] : acc[j];
+
+  min = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    min = acc[j] < min ? acc[j] : min;
+
+  for (; i < da->size; ++i)
+    min = d[i] < min ? d[i] : min;
+
+  return min;
+}
+
+CLOMY__SIMD short
+clomy_da_short_max (clomy_da_short *da)
+{
+  const short *d = da->data;
+  short acc[CLOMY__LANES], max;
+  size_t i, j;
+
+  if (!da->size)
+    return 0;
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    acc[j] = d[0];
+
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] = d[i + j] > acc[j] ? d[i + j] : acc[j];
+
+  max = acc[0];
+  for (j = 1; j < CLOMY__LANES; ++j)
+    max = acc[j] > max ? acc[j] : max;
+
+  for (; i < da->size; ++i)
+    max = d[i] > max ? d[i] : max;
+
+  return max;
+}
+
+CLOMY__SIMD short
+clomy_da_short_dot (clomy_da_short *a, clomy_da_short *b)
+{
+  const short *x = a->data, *y = b->data;
+  short acc[CLOMY__LANES] = { 0 }, dot = 0;
+  size_t i, j;
+
+  CLOMY_FAILFALSE (a->size == b->size, "Arrays differ in size.");
+
+  for (i = 0; i + CLOMY__LANES <= a->size; i += CLOMY__LANES)
+    for (j = 0; j < CLOMY__LANES; ++j)
+      acc[j] += x[i + j] * y[i + j];
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    dot += acc[j];
+
+  for (; i < a->size; ++i)
+    dot += x[i] * y[i];
+
+  return dot;
+}
+
+CLOMY__SIMD void
+clomy_da_short_scale (clomy_da_short *da, short k)
+{
+  short *d = da->data;
+  size_t i;
+
+  for (i = 0; i < da->size; ++i)
+    d[i] *= k;
+}
+
+CLOMY__SIMD void
+clomy_da_short_add (clomy_da_short *dst, clomy_da_short *src)
+{
+  short *d = dst->data;
+  const short *s = src->data;
+  size_t i;
+
+  CLOMY_FAILFALSE (dst->size == src->size, "Arrays differ in size.");
+
+  for (i = 0; i < dst->size; ++i)
+    d[i] += s[i];
+}
+
+CLOMY__SIMD void
+clomy_da_short_prefix_sum (clomy_da_short *da)
+{
+  short *d = da->data;
+  size_t i;
+
+  /* Each sum needs the previous one, only the loads and stores widen. */
+  for (i = 1; i < da->size; ++i)
+    d[i] += d[i - 1];
+}
+
+CLOMY__SIMD size_t
+clomy_da_short_count (clomy_da_short *da, int cmp, short value)
+{
+  const short *d = da->data;
+  short lt = !!(cmp & CLOMY_CMPLT);
+  short eq = !!(cmp & CLOMY_CMPEQ);
+  short gt = !!(cmp & CLOMY_CMPGT);
+  short acc[CLOMY__LANES] = { 0 };
+  size_t i, j, n = 0;
+
+  /* Count in T to keep the lanes as wide as the elements, flushing before
+     a short could overflow. */
+  for (i = 0; i + CLOMY__LANES <= da->size; i += CLOMY__LANES)
+    {
+      for (j = 0; j < CLOMY__LANES; ++j)
+        acc[j] += (d[i + j] < value) * lt + (d[i + j] == value) * eq
+                  + (d[i + j] > value) * gt;
+
+      if ((i / CLOMY__LANES) % 4096 == 4095)
+        for (j = 0; j < CLOMY__LANES; ++j)
+          {
+            n += (size_t)acc[j];
+            acc[j] = 0;
+          }
+    }
+
+  for (j = 0; j < CLOMY__LANES; ++j)
+    n += (size_t)acc[j];
+
+  for (; i < da->size; ++i)
+    n += (d[i] < value && lt) || (d[i] == value && eq) || (d[i] > value && gt);
+
+  return n;
+}
+/**/
+
+/*----------------------------------------------------------------------*/
+
+static const U64 _clomy_hashp[4]
+    = { 0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL,
+        0x589965cc75374cc3ULL };
+
+U64
+_clomy_mum (U64 a, U64 b)
+{
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t)a * b;
+  return (U64)r ^ (U64)(r >> 64);
+#else
+  U64 ha = a >> 32, la = (U32)a, hb = b >> 32, lb = (U32)b;
+  U64 hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+  U64 t = ll + (hl << 32), lo = t + (lh << 32);
+  U64 hi = hh + (hl >> 32) + (lh >> 32) + (t < ll) + (lo < t);
+  return lo ^ hi;
+#endif
+}
+
+U64
+_clomy_read64 (const U8 *p)
+{
+  U64 v;
+  memcpy (&v, p, 8);
+  return v;
+}
+
+U64
+_clomy_read32 (const U8 *p)
+{
+  U32 v;
+  memcpy (&v, p, 4);
+  return v;
+}
+
+U64
+clomy_hashint (U64 x, U64 seed)
+{
+  const U64 *k = _clomy_hashp;
+  return _clomy_mum (_clomy_mum (x ^ seed ^ k[0], x ^ k[1]) ^ k[2],
+                     seed ^ k[3]);
+}
+
+U64
+clomy_hashbytes (const void *data, size_t n, U64 seed)
+{
+  const U64 *k = _clomy_hashp;
+  const U8 *p = data;
+  U64 a, b, s1, s2;
+  size_t i = n;
+
+  seed ^= _clomy_mum (seed ^ k[0], k[1]);
+
+  if (n <= 16)
+    {
+      if (n >= 4)
+        {
+          /* Overlapping reads cover 4 to 16 bytes without a loop. */
+          a = (_clomy_read32 (p) << 32)
+              | _clomy_read32 (p + ((n >> 3) << 2));
+          b = (_clomy_read32 (p + n - 4) << 32)
+              | _clomy_read32 (p + n - 4 - ((n >> 3) << 2));
+        }
+      else if (n > 0)
+        {
+          a = ((U64)p[0] << 16) | ((U64)p[n >> 1] << 8) | p[n - 1];
+          b = 0;
+        }
+      else
+        a = b = 0;
+    }
+  else
+    {
+      if (i > 48)
+        {
+          /* Three independent lanes keep the multipliers busy on long
+             keys. */
+          s1 = s2 = seed;
+          do
+            {
+              seed = _clomy_mum (_clomy_read64 (p) ^ k[1],
+                                 _clomy_read64 (p + 8) ^ seed);
+              s1 = _clomy_mum (_clomy_read64 (p + 16) ^ k[2],
+                               _clomy_read64 (p + 24) ^ s1);
+              s2 = _clomy_mum (_clomy_read64 (p + 32) ^ k[3],
+                               _clomy_read64 (p + 40) ^ s2);
+              p += 48;
+              i -= 48;
+            }
+          while (i > 48);
+
+          seed ^= s1 ^ s2;
+        }
+
+      while (i > 16)
+        {
+          seed = _clomy_mum (_clomy_read64 (p) ^ k[1],
+                             _clomy_read64 (p + 8) ^ seed);
+          p += 16;
+          i -= 16;
+        }
+
+      a = _clomy_read64 (p + i - 16);
+      b = _clomy_read64 (p + i - 8);
+    }
+
+  return _clomy_mum (_clomy_mum (a ^ k[1], b ^ seed) ^ k[0] ^ n, k[1]);
+}
+
+U64
+_clomy_hash_int (clomy_ht *ht, U64 x)
+{
+  return CLOMY_HASH_INT (ht->seed, x);
+}
+
+U64
+_clomy_hash_str (clomy_ht *ht, const char *x, size_t n)
+{
+  return CLOMY_HASH_STR (ht->seed, x, n);
+}
+
+int
+_clomy_stmatch (clomy_stdata *data, const char *key, size_t n, U64 hash)
+{
+  /* Most mismatches stop at the hash, before touching the key. */
+  return data->hash == hash && data->keylen == n
+         && memcmp (data->key, key, n) == 0;
+}
+
+void *
+_clomy_htnew (clomy_ht *ht, size_t size, int str)
+{
+  if (ht->flags & CLOMY_HTDENSE)
+    {
+      ht->stride = CLOMY_ALIGN_UP (size, 8);
+      if (ht->used == ht->room && _clomy_htpack (ht, str))
+        return NULL;
+
+      return ht->entries + ht->used++ * ht->stride;
+    }
+
+  if (!(ht->flags & CLOMY_HTPOOL))
+    return clomy_aralloc (ht->ar, size);
+
+  /* The entry size depends on the key type, size the pool on first use. */
+  if (!ht->nodes.size)
+    clomy_poolinit (&ht->nodes, ht->ar, size);
+
+  return clomy_poolalloc (&ht->nodes);
+}
+
+void
+_clomy_htfree (clomy_ht *ht, void *data)
+{
+  /* Deleted dense entries point to themselves until packed. */
+  if (ht->flags & CLOMY_HTDENSE)
+    ((clomy_htdata *)data)->next = data;
+  else if (ht->flags & CLOMY_HTPOOL)
+    clomy_poolfree (&ht->nodes, data);
+  else
+    _clomy_arrelease (ht->ar, data);
+}
+
+void
+_clomy_stfree (clomy_ht *ht, clomy_stdata *data)
+{
+  if (data->key != CLOMY_STKEY (ht, data))
+    _clomy_arrelease (ht->ar, data->key);
+
+  if (ht->flags & CLOMY_HTDENSE)
+    data->next = data;
+  else
+    _clomy_htfree (ht, data);
+}
+
+U32
+_clomy_htgroup (const U8 *ctrl, U8 c)
+{
+#if defined(__SSE2__) || defined(_M_X64)
+  __m128i group = _mm_loadu_si128 ((const __m128i *)ctrl);
+  return (U32)_mm_movemask_epi8 (
+      _mm_cmpeq_epi8 (group, _mm_set1_epi8 ((char)c)));
+#else
+  U32 mask = 0, i;
+
+  for (i = 0; i < CLOMY_HTGROUP; ++i)
+    mask |= (U32)(ctrl[i] == c) << i;
+
+  return mask;
+#endif /* defined(__SSE2__) || defined(_M_X64) */
+}
+
+U32
+_clomy_htgroupfree (const U8 *ctrl)
+{
+  /* Only empty and deleted slots have the top bit set. */
+#if defined(__SSE2__) || defined(_M_X64)
+  return (U32)_mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *)ctrl));
+#else
+  U32 mask = 0, i;
+
+  for (i = 0; i < CLOMY_HTGROUP; ++i)
+    mask |= (U32)(ctrl[i] >> 7) << i;
+
+  return mask;
+#endif /* defined(__SSE2__) || defined(_M_X64) */
+}
+
+void
+_clomy_htsetctrl (clomy_ht *ht, size_t i, U8 c)
+{
+  /* The first group is mirrored past the end so groups never wrap. */
+  ht->ctrl[i] = c;
+  if (i < CLOMY_HTGROUP)
+    ht->ctrl[ht->capacity + i] = c;
+}
+
+U8 *
+_clomy_htfind (clomy_ht *ht, U64 key, U64 hash)
+{
+  size_t mask = ht->capacity - 1, pos = (hash >> 7) & mask, step = 0;
+  size_t stride = CLOMY_HTSLOT_SIZE (ht);
+  U8 *slot;
+  U32 bits;
+
+  for (;;)
+    {
+      bits = _clomy_htgroup (ht->ctrl + pos, hash & 0x7F);
+      for (; bits; bits &= bits - 1)
+        {
+          slot = (U8 *)ht->data
+                 + ((pos + _clomy_ctz (bits)) & mask) * stride;
+          if (*(U64 *)slot == key)
+            return slot;
+        }
+
+      /* The key would have been put in the first empty slot. */
+      if (_clomy_htgroup (ht->ctrl + pos, CLOMY_HTEMPTY))
+        return NULL;
+
+      step += CLOMY_HTGROUP;
+      pos = (pos + step) & mask;
+    }
+}
+
+size_t
+_clomy_htfindfree (clomy_ht *ht, U64 hash)
+{
+  size_t mask = ht->capacity - 1, pos = (hash >> 7) & mask, step = 0;
+  U32 bits;
+
+  while (!(bits = _clomy_htgroupfree (ht->ctrl + pos)))
+    {
+      step += CLOMY_HTGROUP;
+      pos = (pos + step) & mask;
+    }
+
+  return (pos + _clomy_ctz (bits)) & mask;
+}
+
+int
+_clomy_htrehash (clomy_ht *ht, size_t capacity)
+{
+  U8 *old = (U8 *)ht->data, *oldctrl = ht->ctrl, *slot;
+  size_t oldcap = ht->capacity, stride = CLOMY_HTSLOT_SIZE (ht), i, j;
+  U64 hash;
+
+  slot = clomy_aralloc (ht->ar, capacity * stride + capacity + CLOMY_HTGROUP);
+  if (!slot)
+    return 1;
+
+  ht->data = (void **)slot;
+  ht->ctrl = slot + capacity * stride;
+  ht->capacity = capacity;
+  ht->deleted = 0;
+  memset (ht->ctrl, CLOMY_HTEMPTY, capacity + CLOMY_HTGROUP);
+
+  for (i = 0; i < oldcap; ++i)
+    {
+      if (oldctrl[i] & CLOMY_HTEMPTY)
+        continue;
+
+      slot = old + i * stride;
+      hash = _clomy_hash_int (ht, *(U64 *)slot);
+      j = _clomy_htfindfree (ht, hash);
+      _clomy_htsetctrl (ht, j, hash & 0x7F);
+      memcpy ((U8 *)ht->data + j * stride, slot, stride);
+    }
+
+  if (old)
+    _clomy_arrelease (ht->ar, old);
+
+  return 0;
+}
+
+void *
+_clomy_htoupsert (clomy_ht *ht, U64 key, U64 hash, int *isnew)
+{
+  U8 *slot = _clomy_htfind (ht, key, hash);
+  size_t cap = ht->capacity, i;
+
+  if (!slot)
+    {
+      /* Past 7/8 load grow, or just sweep the deleted slots if most of the
+         load is deleted. */
+      if ((ht->size + ht->deleted + 1) * 8 > cap * 7)
+        {
+          if ((ht->size + 1) * 16 > cap * 7)
+            cap *= 2;
+
+          if (_clomy_htrehash (ht, cap))
+            return NULL;
+        }
+
+      i = _clomy_htfindfree (ht, hash);
+      if (ht->ctrl[i] == CLOMY_HTDELETED)
+        --ht->deleted;
+
+      _clomy_htsetctrl (ht, i, hash & 0x7F);
+      slot = (U8 *)ht->data + i * CLOMY_HTSLOT_SIZE (ht);
+      *(U64 *)slot = key;
+      memset (slot + 8, 0, ht->data_size);
+      ++ht->size;
+
+      if (isnew)
+        *isnew = 1;
+    }
+
+  return slot + 8;
+}
+
+int
+_clomy_htpack (clomy_ht *ht, int str)
+{
+  U8 *entries = ht->entries, *src, *dst;
+  size_t room = ht->room, stride = ht->stride, i, n = 0;
+  clomy_htdata *hd;
+  clomy_stdata *sd;
+  void **bucket;
+
+  /* Grow, unless deletes left half the array free to pack in place. */
+  if (ht->size * 2 >= room)
+    {
+      room = room ? room * 2 : 8;
+      entries = clomy_aralloc (ht->ar, room * stride);
+      if (!entries)
+        return 1;
+    }
+
+  /* Every entry is linked again, which also ends a resize. */
+  memset (ht->data, 0, ht->capacity * sizeof (void *));
+  if (ht->old)
+    {
+      _clomy_arrelease (ht->ar, ht->old);
+      ht->old = NULL;
+      ht->oldcap = 0;
+    }
+
+  for (i = 0; i < ht->used; ++i)
+    {
+      src = ht->entries + i * stride;
+      dst = entries + n * stride;
+      if (str ? ((clomy_stdata *)src)->next == (void *)src
+              : ((clomy_htdata *)src)->next == (void *)src)
+        continue;
+
+      memmove (dst, src, stride);
+      ++n;
+
+      if (str)
+        {
+          sd = (clomy_stdata *)dst;
+          if (sd->key == CLOMY_STKEY (ht, (clomy_stdata *)src))
+            sd->key = CLOMY_STKEY (ht, sd);
+
+          bucket = &ht->data[sd->hash & (ht->capacity - 1)];
+          sd->next = *bucket;
+          *bucket = sd;
+        }
+      else
+        {
+          hd = (clomy_htdata *)dst;
+          bucket = &ht->data[_clomy_hash_int (ht, hd->key)
+                             & (ht->capacity - 1)];
+          hd->next = *bucket;
+          *bucket = hd;
+        }
+    }
+
+  if (entries != ht->entries)
+    _clomy_arrelease (ht->ar, ht->entries);
+
+  ht->entries = entries;
+  ht->used = n;
+  ht->room = room;
+
+  return 0;
+}
+
+int
+_clomy_htresize (clomy_ht *ht, size_t capacity)
+{
+  void **data;
+
+  data = clomy_aralloc (ht->ar, capacity * sizeof (void *));
+  if (!data)
+    return 1;
+
+  memset (data, 0, capacity * sizeof (void *));
+
+  /* The entries move over a few buckets at a time. */
+  ht->old = ht->data;
+  ht->oldcap = ht->capacity;
+  ht->moved = 0;
+  ht->data = data;
+  ht->capacity = capacity;
+
+  return 0;
+}
+
+void
+_clomy_htshrink (clomy_ht *ht)
+{
+  size_t capacity = ht->capacity;
+
+  while (capacity / 2 >= 8 && ht->size * 2 < capacity)
+    capacity /= 2;
+
+  _clomy_htresize (ht, capacity);
+}
+
+
+void
+_clomy_htmove (clomy_ht *ht, size_t i)
+{
+  clomy_htdata *ptr, *next, **tail;
+  size_t j;
+
+  for (ptr = ht->old[i]; ptr; ptr = next)
+    {
+      next = ptr->next;
+      ptr->next = NULL;
+
+      /* Appending keeps newer entries of a key in front. */
+      j = _clomy_hash_int (ht, ptr->key) & (ht->capacity - 1);
+      tail = (clomy_htdata **)&ht->data[j];
+      while (*tail)
+        tail = &(*tail)->next;
+
+      *tail = ptr;
+    }
+
+  ht->old[i] = NULL;
+}
+
+void
+_clomy_htstep (clomy_ht *ht, U64 hash)
+{
+  size_t n;
+
+  /* The bucket of the key goes first, so its entries are all in data. */
+  _clomy_htmove (ht, hash & (ht->oldcap - 1));
+
+  for (n = 0; n < CLOMY_HASHTABLE_REHASH_STEP && ht->moved < ht->oldcap; ++n)
+    _clomy_htmove (ht, ht->moved++);
+
+  if (ht->moved == ht->oldcap)
+    {
+      _clomy_arrelease (ht->ar, ht->old);
+      ht->old = NULL;
+      ht->oldcap = 0;
+    }
+}
+
+
+void
+_clomy_stmove (clomy_ht *ht, size_t i)
+{
+  clomy_stdata *ptr, *next, **tail;
+  size_t j;
+
+  for (ptr = ht->old[i]; ptr; ptr = next)
+    {
+      next = ptr->next;
+      ptr->next = NULL;
+
+      /* Appending keeps newer entries of a key in front. */
+      j = ptr->hash & (ht->capacity - 1);
+      tail = (clomy_stdata **)&ht->data[j];
+      while (*tail)
+        tail = &(*tail)->next;
+
+      *tail = ptr;
+    }
+
+  ht->old[i] = NULL;
+}
+
+void
+_clomy_ststep (clomy_ht *ht, U64 hash)
+{
+  size_t n;
+
+  /* The bucket of the key goes first, so its entries are all in data. */
+  _clomy_stmove (ht, hash & (ht->oldcap - 1));
+
+  for (n = 0; n < CLOMY_HASHTABLE_REHASH_STEP && ht->moved < ht->oldcap; ++n)
+    _clomy_stmove (ht, ht->moved++);
+
+  if (ht->moved == ht->oldcap)
+    {
+      _clomy_arrelease (ht->ar, ht->old);
+      ht->old = NULL;
+      ht->oldcap = 0;
+    }
+}
+
+#if defined(CLOMY_THREADS)
+void
+_clomy_htlock (atomic_flag *lock)
+{
+  while (atomic_flag_test_and_set_explicit (lock, memory_order_acquire))
+    ;
+}
+
+void
+_clomy_htunlock (atomic_flag *lock)
+{
+  atomic_flag_clear_explicit (lock, memory_order_release);
+}
+
+clomy_htreader *
+_clomy_htreader (clomy_ht *ht)
+{
+  clomy_htreader *r;
+
+  if (CLOMY__htrid == ht->id)
+    return CLOMY__htreader;
+
+  for (r = atomic_load (&ht->readers); r; r = r->next)
+    if (r->owner == &CLOMY__thread)
+      break;
+
+  if (!r)
+    {
+      r = clomy_aralloc (ht->ar, sizeof (clomy_htreader));
+      CLOMY_FAILFALSE (r, "Reader not allocated.");
+
+      atomic_init (&r->epoch, 0);
+      r->depth = 0;
+      r->owner = &CLOMY__thread;
+
+      r->next = atomic_load (&ht->readers);
+      while (!atomic_compare_exchange_weak (&ht->readers, &r->next, r))
+        ;
+    }
+
+  CLOMY__htrid = ht->id;
+  CLOMY__htreader = r;
+  return r;
+}
+
+void
+_clomy_htretire (clomy_ht *ht, void *data, int str)
+{
+  clomy_htretired *r = clomy_aralloc (ht->ar, sizeof (clomy_htretired));
+  CLOMY_FAILFALSE (r, "Retired entry not allocated.");
+
+  r->data = data;
+  r->str = str;
+  r->epoch = atomic_fetch_add (&ht->epoch, 1);
+
+  _clomy_htlock (&ht->retiring);
+  r->next = ht->retired;
+  ht->retired = r;
+  if (++ht->nretired >= CLOMY_HASHTABLE_RECLAIM)
+    _clomy_htreclaim (ht, 0);
+  _clomy_htunlock (&ht->retiring);
+}
+
+void
+_clomy_htreclaim (clomy_ht *ht, int all)
+{
+  clomy_htretired **link, *r;
+  clomy_htreader *rd;
+  U64 min = (U64)-1, e;
+
+  /* An entry unlinked at epoch E can only be seen by readers that entered
+     at E or before. */
+  atomic_thread_fence (memory_order_seq_cst);
+  for (rd = atomic_load (&ht->readers); rd && !all; rd = rd->next)
+    if ((e = atomic_load (&rd->epoch)) && e < min)
+      min = e;
+
+  for (link = &ht->retired; (r = *link);)
+    {
+      if (r->epoch >= min)
+        {
+          link = &r->next;
+          continue;
+        }
+
+      *link = r->next;
+      if (r->str)
+        _clomy_stfree (ht, r->data);
+      else
+        _clomy_htfree (ht, r->data);
+
+      _clomy_arrelease (ht->ar, r);
+      --ht->nretired;
+    }
+}
+
+void
+_clomy_htcfold (clomy_ht *ht)
+{
+  clomy_htreader *r, *next;
+
+  _clomy_htreclaim (ht, 1);
+
+  for (r = atomic_load (&ht->readers); r; r = next)
+    {
+      next = r->next;
+      _clomy_arrelease (ht->ar, r);
+    }
+
+  atomic_store (&ht->readers, NULL);
+  _clomy_arrelease (ht->ar, ht->locks);
+  ht->locks = NULL;
+}
+
+void *
+_clomy_htcput (clomy_ht *ht, U64 key, void *value, int *isnew)
+{
+  clomy_htdata *ptr, *data;
+  U64 hash = _clomy_hash_int (ht, key);
+  size_t i = hash & (ht->capacity - 1);
+  atomic_flag *lock = &ht->locks[i & (CLOMY_HASHTABLE_STRIPES - 1)];
+
+  _clomy_htlock (lock);
+
+  /* Only writers of this stripe change the links, so plain loads do. */
+  for (ptr = ht->data[i]; ptr; ptr = ptr->next)
+    if (ptr->key == key)
+      break;
+
+  /* Existing entries are updated in place under the stripe lock, so a
+     racing _clomy_htcinc isn't lost on a replaced entry. */
+  if (ptr)
+    {
+      if (value)
+        memcpy (ptr->data, value, ht->data_size);
+
+      _clomy_htunlock (lock);
+      return ptr->data;
+    }
+
+  data = _clomy_htnode (ht, key);
+  if (!data)
+    {
+      _clomy_htunlock (lock);
+      return NULL;
+    }
+
+  if (value)
+    memcpy (data->data, value, ht->data_size);
+
+  /* The entry is complete before readers can reach it. */
+  data->next = ht->data[i];
+  CLOMY__HTSTORE (ht->data[i], data);
+
+  _clomy_htunlock (lock);
+
+  CLOMY__HTSIZE (ht, 1);
+  if (isnew)
+    *isnew = 1;
+
+  return data->data;
+}
+
+int
+_clomy_htcinc (clomy_ht *ht, U64 key)
+{
+  clomy_htdata *ptr;
+  U64 hash = _clomy_hash_int (ht, key);
+  size_t i = hash & (ht->capacity - 1);
+  atomic_flag *lock = &ht->locks[i & (CLOMY_HASHTABLE_STRIPES - 1)];
+
+  _clomy_htlock (lock);
+
+  for (ptr = ht->data[i]; ptr; ptr = ptr->next)
+    if (ptr->key == key)
+      break;
+
+  if (ptr)
+    {
+      ++*(int *)ptr->data;
+      _clomy_htunlock (lock);
+      return 0;
+    }
+
+  ptr = _clomy_htnode (ht, key);
+  if (!ptr)
+    {
+      _clomy_htunlock (lock);
+      return 1;
+    }
+
+  *(int *)ptr->data = 1;
+  ptr->next = ht->data[i];
+  CLOMY__HTSTORE (ht->data[i], ptr);
+
+  _clomy_htunlock (lock);
+
+  CLOMY__HTSIZE (ht, 1);
+  return 0;
+}
+
+void *
+_clomy_htcget (clomy_ht *ht, U64 key)
+{
+  clomy_htdata *ptr;
+  U64 hash = _clomy_hash_int (ht, key);
+  void *data = NULL;
+
+  clomy_htenter (ht);
+  for (ptr = CLOMY__HTLOAD (ht->data[hash & (ht->capacity - 1)]); ptr;
+       ptr = CLOMY__HTLOAD (ptr->next))
+    if (ptr->key == key)
+      {
+        data = ptr->data;
+        break;
+      }
+  clomy_htleave (ht);
+
+  return data;
+}
+
+void
+_clomy_htcdel (clomy_ht *ht, U64 key)
+{
+  clomy_htdata *ptr, **link;
+  U64 hash = _clomy_hash_int (ht, key);
+  size_t i = hash & (ht->capacity - 1);
+  atomic_flag *lock = &ht->locks[i & (CLOMY_HASHTABLE_STRIPES - 1)];
+
+  _clomy_htlock (lock);
+
+  link = (clomy_htdata **)&ht->data[i];
+  for (ptr = *link; ptr; link = &ptr->next, ptr = *link)
+    if (ptr->key == key)
+      break;
+
+  /* Readers on the entry still see its next link. */
+  if (ptr)
+    CLOMY__HTSTORE (*link, ptr->next);
+
+  _clomy_htunlock (lock);
+
+  if (ptr)
+    {
+      CLOMY__HTSIZE (ht, -1);
+      _clomy_htretire (ht, ptr, 0);
+    }
+}
+
+void *
+_clomy_stcput (clomy_ht *ht, const char *key, size_t keylen, void *value, int *isnew)
+{
+  clomy_stdata *ptr, *data;
+  U64 hash = _clomy_hash_str (ht, key, keylen);
+  size_t i = hash & (ht->capacity - 1);
+  atomic_flag *lock = &ht->locks[i & (CLOMY_HASHTABLE_STRIPES - 1)];
+
+  _clomy_htlock (lock);
+
+  /* Only writers of this stripe change the links, so plain loads do. */
+  for (ptr = ht->data[i]; ptr; ptr = ptr->next)
+    if (_clomy_stmatch (ptr, key, keylen, hash))
+      break;
+
+  /* Existing entries are updated in place under the stripe lock, so a
+     racing _clomy_stcinc isn't lost on a replaced entry. */
+  if (ptr)
+    {
+      if (value)
+        memcpy (ptr->data, value, ht->data_size);
+
+      _clomy_htunlock (lock);
+      return ptr->data;
+    }
+
+  data = _clomy_stnode (ht, key, keylen, hash);
+  if (!data)
+    {
+      _clomy_htunlock (lock);
+      return NULL;
+    }
+
+  if (value)
+    memcpy (data->data, value, ht->data_size);
+
+  /* The entry is complete before readers can reach it. */
+  data->next = ht->data[i];
+  CLOMY__HTSTORE (ht->data[i], data);
+
+  _clomy_htunlock (lock);
+
+  CLOMY__HTSIZE (ht, 1);
+  if (isnew)
+    *isnew = 1;
+
+  return data->data;
+}
+
+int
+_clomy_stcinc (clomy_ht *ht, const char *key, size_t keylen)
+{
+  clomy_stdata *ptr;
+  U64 hash = _clomy_hash_str (ht, key, keylen);
+  size_t i = hash & (ht->capacity - 1);
+  atomic_flag *lock = &ht->locks[i & (CLOMY_HASHTABLE_STRIPES - 1)];
+
+  _clomy_htlock (lock);
+
+  for (ptr = ht->data[i]; ptr; ptr = ptr->next)
+    if (_clomy_stmatch (ptr, key, keylen, hash))
+      break;
+
+  if (ptr)
+    {
+      ++*(int *)ptr->data;
+      _clomy_htunlock (lock);
+      return 0;
+    }
+
+  ptr = _clomy_stnode (ht, key, keylen, hash);
+  if (!ptr)
+    {
+      _clomy_htunlock (lock);
+      return 1;
+    }
+
+  *(int *)ptr->data = 1;
+  ptr->next = ht->data[i];
+  CLOMY__HTSTORE (ht->data[i], ptr);
+
+  _clomy_htunlock (lock);
+
+  CLOMY__HTSIZE (ht, 1);
+  return 0;
+}
+
+void *
+_clomy_stcget (clomy_ht *ht, const char *key, size_t keylen)
+{
+  clomy_stdata *ptr;
+  U64 hash = _clomy_hash_str (ht, key, keylen);
+  void *data = NULL;
+
+  clomy_htenter (ht);
+  for (ptr = CLOMY__HTLOAD (ht->data[hash & (ht->capacity - 1)]); ptr;
+       ptr = CLOMY__HTLOAD (ptr->next))
+    if (_clomy_stmatch (ptr, key, keylen, hash))
+      {
+        data = ptr->data;
+        break;
+      }
+  clomy_htleave (ht);
+
+  return data;
+}
+
+void
+_clomy_stcdel (clomy_ht *ht, const char *key, size_t keylen)
+{
+  clomy_stdata *ptr, **link;
+  U64 hash = _clomy_hash_str (ht, key, keylen);
+  size_t i = hash & (ht->capacity - 1);
+  atomic_flag *lock = &ht->locks[i & (CLOMY_HASHTABLE_STRIPES - 1)];
+
+  _clomy_htlock (lock);
+
+  link = (clomy_stdata **)&ht->data[i];
+  for (ptr = *link; ptr; link = &ptr->next, ptr = *link)
+    if (_clomy_stmatch (ptr, key, keylen, hash))
+      break;
+
+  /* Readers on the entry still see its next link. */
+  if (ptr)
+    CLOMY__HTSTORE (*link, ptr->next);
+
+  _clomy_htunlock (lock);
+
+  if (ptr)
+    {
+      CLOMY__HTSIZE (ht, -1);
+      _clomy_htretire (ht, ptr, 1);
+    }
+}
+
+#endif /* defined(CLOMY_THREADS) */
+
+void
+clomy_htenter (clomy_ht *ht)
+{
+#if defined(CLOMY_THREADS)
+  clomy_htreader *r;
+
+  if (!(ht->flags & CLOMY_HTCONCURRENT))
+    return;
+
+  r = _clomy_htreader (ht);
+  if (r->depth++ == 0)
+    {
+      atomic_store (&r->epoch, atomic_load (&ht->epoch));
+      atomic_thread_fence (memory_order_seq_cst);
+    }
+#else
+  (void)ht;
+#endif /* defined(CLOMY_THREADS) */
+}
+
+void
+clomy_htleave (clomy_ht *ht)
+{
+#if defined(CLOMY_THREADS)
+  clomy_htreader *r;
+
+  if (!(ht->flags & CLOMY_HTCONCURRENT))
+    return;
+
+  r = _clomy_htreader (ht);
+  if (--r->depth == 0)
+    atomic_store_explicit (&r->epoch, 0, memory_order_release);
+#else
+  (void)ht;
+#endif /* defined(CLOMY_THREADS) */
+}
+
+U64
+_clomy_htseed (clomy_ht *ht)
+{
+  U8 frame;
+
+  /* ASLR moves the table and the stack between runs, the previous seed
+     tells apart tables initialized again at the same address. */
+  return clomy_hashint ((size_t)ht ^ ht->seed, (size_t)&frame);
+}
+
+int
+clomy_htinit (clomy_ht *ht, clomy_arena *ar, size_t capacity, size_t dsize)
+{
+  CLOMY_FAILFALSE (ar, "Arena is required.");
+
+  size_t size;
+
+  /* Power of two capacity lets buckets be found with a mask. */
+  capacity = capacity < 8 ? 8 : capacity;
+  capacity = (size_t)1 << (_clomy_log2 (capacity - 1) + 1);
+  size = capacity * sizeof (clomy_htdata *);
+  if (!(ht->flags & CLOMY_HTSEED))
+    ht->seed = _clomy_htseed (ht);
+
+  ht->ar = ar;
+  ht->data_size = dsize;
+  ht->size = 0;
+  ht->capacity = capacity;
+  ht->nodes.size = 0;
+  ht->old = NULL;
+  ht->oldcap = 0;
+  ht->entries = NULL;
+  ht->used = 0;
+  ht->room = 0;
+
+  CLOMY_FAILTRUE ((ht->flags & CLOMY_HTDENSE)
+                      && (ht->flags & (CLOMY_HTOPEN | CLOMY_HTPOOL
+                                       | CLOMY_HTCONCURRENT)),
+                  "Dense tables are chained and not pooled.");
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    {
+      CLOMY_FAILFALSE (ar->flags & CLOMY_ARSHARED,
+                       "Concurrent tables need a shared arena.");
+      CLOMY_FAILTRUE (ht->flags & (CLOMY_HTOPEN | CLOMY_HTPOOL),
+                      "Concurrent tables are chained and not pooled.");
+
+      ht->locks = clomy_aralloc (ar, CLOMY_HASHTABLE_STRIPES
+                                         * sizeof (atomic_flag));
+      if (!ht->locks)
+        return 1;
+
+      for (size_t i = 0; i < CLOMY_HASHTABLE_STRIPES; ++i)
+        atomic_flag_clear (&ht->locks[i]);
+
+      atomic_flag_clear (&ht->retiring);
+      atomic_init (&ht->epoch, 1);
+      atomic_init (&ht->readers, NULL);
+      ht->retired = NULL;
+      ht->nretired = 0;
+      ht->id = atomic_fetch_add (&CLOMY__arid, 1) + 1;
+    }
+#else
+  CLOMY_FAILTRUE (ht->flags & CLOMY_HTCONCURRENT,
+                  "Concurrent tables need CLOMY_THREADS.");
+#endif /* defined(CLOMY_THREADS) */
+
+  if (ht->flags & CLOMY_HTOPEN)
+    {
+      ht->data = NULL;
+      ht->ctrl = NULL;
+      ht->capacity = 0;
+      capacity = capacity < CLOMY_HTGROUP ? CLOMY_HTGROUP : capacity;
+      return _clomy_htrehash (ht, capacity);
+    }
+  ht->data = clomy_aralloc (ar, size);
+  if (!ht->data)
     return 1;
 
-  da->data_size = data_size;
-  da->size = 0;
-  da->capacity = CLOMY_ALIGN_UP (capacity, 8);
+  memset (ht->data, 0, size);
+
+  return 0;
+}
+
+int
+clomy_btinit (clomy_ht *ht, clomy_arena *ar, size_t capacity, size_t ksize,
+              size_t dsize)
+{
+  ht->key_size = ksize;
+  return clomy_htinit (ht, ar, capacity, dsize);
+}
+
+clomy_htdata *
+_clomy_htnode (clomy_ht *ht, U64 key)
+{
+  clomy_htdata *data;
+
+  data = _clomy_htnew (ht, sizeof (clomy_htdata) + ht->data_size, 0);
+  if (!data)
+    return NULL;
+
+  data->key = key;
+  data->next = NULL;
+  memset (data->data, 0, ht->data_size);
+
+  return data;
+}
+
+clomy_stdata *
+_clomy_stnode (clomy_ht *ht, const char *key, size_t keylen, U64 hash)
+{
+  clomy_stdata *data;
+  size_t size;
+
+  /* The key follows the value, in the same allocation. Pool and dense
+     entries have a fixed size, so only short keys fit. */
+  size = sizeof (clomy_stdata) + CLOMY_ALIGN_UP (ht->data_size, 8);
+  if (ht->flags & (CLOMY_HTPOOL | CLOMY_HTDENSE))
+    size += CLOMY_HASHTABLE_INLINE_KEY;
+  else
+    size += keylen + 1;
+
+  data = _clomy_htnew (ht, size, 1);
+  if (!data)
+    return NULL;
+
+  data->key = CLOMY_STKEY (ht, data);
+  if (keylen + 1 > size - (size_t)(data->key - (char *)data))
+    {
+      data->key = clomy_aralloc (ht->ar, keylen + 1);
+      if (!data->key)
+        {
+          _clomy_stfree (ht, data);
+          return NULL;
+        }
+    }
+
+  memcpy (data->key, key, keylen);
+  data->key[keylen] = '\0';
+  data->hash = hash;
+  data->keylen = keylen;
+  data->next = NULL;
+  memset (data->data, 0, ht->data_size);
+
+  return data;
+}
+
+void *
+_clomy_htupsert (clomy_ht *ht, U64 key, int *isnew)
+{
+  return _clomy_htupserth (ht, key, _clomy_hash_int (ht, key), isnew);
+}
+
+void *
+_clomy_htupserth (clomy_ht *ht, U64 key, U64 hash, int *isnew)
+{
+  clomy_htdata *data;
+  size_t i;
+
+  if (isnew)
+    *isnew = 0;
+
+  if (ht->flags & CLOMY_HTOPEN)
+    return _clomy_htoupsert (ht, key, hash, isnew);
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_htcput (ht, key, NULL, isnew);
+#endif /* defined(CLOMY_THREADS) */
+
+  if (!ht->old && ht->size >= ht->capacity)
+    _clomy_htresize (ht, ht->capacity * 2);
+
+  if (ht->old)
+    _clomy_htstep (ht, hash);
+
+  i = hash & (ht->capacity - 1);
+  for (data = ht->data[i]; data; data = data->next)
+    if (data->key == key)
+      return data->data;
+
+  data = _clomy_htnode (ht, key);
+  if (!data)
+    return NULL;
+
+  data->next = ht->data[i];
+  ht->data[i] = data;
+  ++ht->size;
+
+  if (isnew)
+    *isnew = 1;
+
+  return data->data;
+}
+
+void *
+_clomy_stupsert (clomy_ht *ht, const char *key, size_t keylen, int *isnew)
+{
+  return _clomy_stupserth (ht, key, keylen, _clomy_hash_str (ht, key, keylen),
+                           isnew);
+}
+
+void *
+_clomy_stupserth (clomy_ht *ht, const char *key, size_t keylen, U64 hash,
+                  int *isnew)
+{
+  clomy_stdata *data;
+  size_t i;
+
+  CLOMY_FAILTRUE (ht->flags & CLOMY_HTOPEN,
+                  "String keys need a chained table.");
+
+  if (isnew)
+    *isnew = 0;
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_stcput (ht, key, keylen, NULL, isnew);
+#endif /* defined(CLOMY_THREADS) */
+
+  if (!ht->old && ht->size >= ht->capacity)
+    _clomy_htresize (ht, ht->capacity * 2);
+
+  if (ht->old)
+    _clomy_ststep (ht, hash);
+
+  i = hash & (ht->capacity - 1);
+  for (data = ht->data[i]; data; data = data->next)
+    if (_clomy_stmatch (data, key, keylen, hash))
+      return data->data;
+
+  data = _clomy_stnode (ht, key, keylen, hash);
+  if (!data)
+    return NULL;
+
+  data->next = ht->data[i];
+  ht->data[i] = data;
+  ++ht->size;
+
+  if (isnew)
+    *isnew = 1;
+
+  return data->data;
+}
+
+
+void *
+_clomy_htget (clomy_ht *ht, U64 key)
+{
+  return _clomy_htgeth (ht, key, _clomy_hash_int (ht, key));
+}
+
+void *
+_clomy_htgeth (clomy_ht *ht, U64 key, U64 hash)
+{
+  clomy_htdata *ptr;
+  U8 *slot;
+
+  if (ht->flags & CLOMY_HTOPEN)
+    {
+      slot = _clomy_htfind (ht, key, hash);
+      return slot ? slot + 8 : NULL;
+    }
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_htcget (ht, key);
+#endif /* defined(CLOMY_THREADS) */
+
+  for (ptr = ht->data[hash & (ht->capacity - 1)]; ptr; ptr = ptr->next)
+    if (ptr->key == key)
+      return ptr->data;
+
+  /* Lookups don't move entries, so check the bucket not rehashed yet. */
+  if (ht->old)
+    for (ptr = ht->old[hash & (ht->oldcap - 1)]; ptr; ptr = ptr->next)
+      if (ptr->key == key)
+        return ptr->data;
+
+  return NULL;
+}
+
+void *
+_clomy_stget (clomy_ht *ht, const char *key, size_t keylen)
+{
+  return _clomy_stgeth (ht, key, keylen, _clomy_hash_str (ht, key, keylen));
+}
+
+void *
+_clomy_stgeth (clomy_ht *ht, const char *key, size_t keylen, U64 hash)
+{
+  clomy_stdata *ptr;
+
+  CLOMY_FAILTRUE (ht->flags & CLOMY_HTOPEN,
+                  "String keys need a chained table.");
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_stcget (ht, key, keylen);
+#endif /* defined(CLOMY_THREADS) */
+
+  for (ptr = ht->data[hash & (ht->capacity - 1)]; ptr; ptr = ptr->next)
+    if (_clomy_stmatch (ptr, key, keylen, hash))
+      return ptr->data;
+
+  if (ht->old)
+    for (ptr = ht->old[hash & (ht->oldcap - 1)]; ptr; ptr = ptr->next)
+      if (_clomy_stmatch (ptr, key, keylen, hash))
+        return ptr->data;
+
+  return NULL;
+}
+
+void
+_clomy_htprefetch (clomy_ht *ht, U64 hash, int node)
+{
+  size_t i = hash & (ht->capacity - 1);
+
+  if (ht->flags & CLOMY_HTOPEN)
+    {
+      /* Probing starts at the top bits, see _clomy_htfind. */
+      i = (hash >> 7) & (ht->capacity - 1);
+      if (!node)
+        {
+          CLOMY__PREFETCH (ht->ctrl + i);
+          CLOMY__PREFETCH ((U8 *)ht->data + i * CLOMY_HTSLOT_SIZE (ht));
+        }
+    }
+  else if (!node)
+    CLOMY__PREFETCH (&ht->data[i]);
+  else if (!(ht->flags & CLOMY_HTCONCURRENT) && ht->data[i])
+    CLOMY__PREFETCH (ht->data[i]);
+}
+
+
+void
+_clomy_htdel (clomy_ht *ht, U64 key)
+{
+  clomy_htdata *ptr, *prev = NULL;
+  U8 *slot;
+  size_t i;
+  U64 hash;
+
+  if (ht->flags & CLOMY_HTOPEN)
+    {
+      slot = _clomy_htfind (ht, key, _clomy_hash_int (ht, key));
+      if (slot)
+        {
+          i = (slot - (U8 *)ht->data) / CLOMY_HTSLOT_SIZE (ht);
+          _clomy_htsetctrl (ht, i, CLOMY_HTDELETED);
+          ++ht->deleted;
+          --ht->size;
+        }
+
+      return;
+    }
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    {
+      _clomy_htcdel (ht, key);
+      return;
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+  hash = _clomy_hash_int (ht, key);
+  if (ht->old)
+    _clomy_htstep (ht, hash);
+
+  i = hash & (ht->capacity - 1);
+  ptr = ht->data[i];
+
+  while (ptr)
+    {
+      if (ptr->key == key)
+        {
+          if (prev)
+            prev->next = ptr->next;
+          else
+            ht->data[i] = ptr->next;
+
+          _clomy_htfree (ht, ptr);
+
+          --ht->size;
+          break;
+        }
+
+      prev = ptr;
+      ptr = ptr->next;
+    }
+
+  /* Shrink once the table is mostly empty. */
+  if (!ht->old && ht->capacity > 8 && ht->size * 8 < ht->capacity)
+    _clomy_htshrink (ht);
+}
+
+void
+_clomy_stdel (clomy_ht *ht, const char *key, size_t keylen)
+{
+  clomy_stdata *ptr, *prev = NULL;
+  size_t i;
+  U64 hash;
+
+  CLOMY_FAILTRUE (ht->flags & CLOMY_HTOPEN,
+                  "String keys need a chained table.");
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    {
+      _clomy_stcdel (ht, key, keylen);
+      return;
+    }
+#endif /* defined(CLOMY_THREADS) */
+
+  hash = _clomy_hash_str (ht, key, keylen);
+  if (ht->old)
+    _clomy_ststep (ht, hash);
+
+  i = hash & (ht->capacity - 1);
+  ptr = ht->data[i];
+
+  while (ptr)
+    {
+      if (_clomy_stmatch (ptr, key, keylen, hash))
+        {
+          if (prev)
+            prev->next = ptr->next;
+          else
+            ht->data[i] = ptr->next;
+
+          _clomy_stfree (ht, ptr);
+
+          --ht->size;
+          break;
+        }
+
+      prev = ptr;
+      ptr = ptr->next;
+    }
+
+  if (!ht->old && ht->capacity > 8 && ht->size * 8 < ht->capacity)
+    _clomy_htshrink (ht);
+}
+
+void *
+clomy_htupsert (clomy_ht *ht, int key, int *isnew)
+{
+  return _clomy_htupsert (ht, (U64)key, isnew);
+}
+
+int
+clomy_htput (clomy_ht *ht, int key, void *value)
+{
+  void *slot;
+
+#if defined(CLOMY_THREADS)
+  /* Readers may be copying the old value, so put a new entry instead. */
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return !_clomy_htcput (ht, (U64)key, value, NULL);
+#endif /* defined(CLOMY_THREADS) */
 
+  slot = _clomy_htupsert (ht, (U64)key, NULL);
+  if (!slot)
+    return 1;
+
+  memcpy (slot, value, ht->data_size);
   return 0;
 }
 
 int
-clomy_dacap (clomy_da *da, size_t capacity)
+clomy_htput_int (clomy_ht *table, int key, int val)
 {
-  void *newarr;
-  if (da->ar)
+  return clomy_htput (table, key, &val);
+}
+int
+clomy_htput_float (clomy_ht *table, int key, float val)
+{
+  return clomy_htput (table, key, &val);
+}
+int
+clomy_htput_long (clomy_ht *table, int key, long val)
+{
+  return clomy_htput (table, key, &val);
+}
+int
+clomy_htput_double (clomy_ht *table, int key, double val)
+{
+  return clomy_htput (table, key, &val);
+}
+int
+clomy_htput_char (clomy_ht *table, int key, char val)
+{
+  return clomy_htput (table, key, &val);
+}
+int
+clomy_htput_short (clomy_ht *table, int key, short val)
+{
+  return clomy_htput (table, key, &val);
+}
+/**/
+
+int
+clomy_htinc_int (clomy_ht *ht, int key)
+{
+  int *ptr;
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_htcinc (ht, (U64)key);
+#endif /* defined(CLOMY_THREADS) */
+
+  ptr = _clomy_htupsert (ht, (U64)key, NULL);
+  if (!ptr)
+    return 1;
+
+  ++*ptr;
+  return 0;
+}
+
+void *
+clomy_htget (clomy_ht *ht, int key)
+{
+  return _clomy_htget (ht, (U64)key);
+}
+
+int *
+clomy_htget_int (clomy_ht *ht, int key)
+{
+  return (int *)_clomy_htget (ht, (U64)key);
+}
+float *
+clomy_htget_float (clomy_ht *ht, int key)
+{
+  return (float *)_clomy_htget (ht, (U64)key);
+}
+long *
+clomy_htget_long (clomy_ht *ht, int key)
+{
+  return (long *)_clomy_htget (ht, (U64)key);
+}
+double *
+clomy_htget_double (clomy_ht *ht, int key)
+{
+  return (double *)_clomy_htget (ht, (U64)key);
+}
+char *
+clomy_htget_char (clomy_ht *ht, int key)
+{
+  return (char *)_clomy_htget (ht, (U64)key);
+}
+short *
+clomy_htget_short (clomy_ht *ht, int key)
+{
+  return (short *)_clomy_htget (ht, (U64)key);
+}
+/**/
+
+void
+_clomy_hthashbatch (clomy_ht *ht, const int *keys, size_t n, U64 *hash)
+{
+  size_t j;
+
+  for (j = 0; j < n; ++j)
+    {
+      int key = keys[j];
+      hash[j] = _clomy_hash_int (ht, (U64)key);
+      _clomy_htprefetch (ht, hash[j], 0);
+    }
+
+  /* The first buckets have arrived while the others were hashed. */
+  for (j = 0; j < n; ++j)
+    _clomy_htprefetch (ht, hash[j], 1);
+}
+
+void
+clomy_htget_batch (clomy_ht *ht, const int *keys, size_t n, void **out)
+{
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
+
+  for (i = 0; i < n; i += m)
     {
-      newarr = aralloc (da->ar, capacity * da->data_size);
-      if (newarr)
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_hthashbatch (ht, keys + i, m, hash);
+
+      for (j = 0; j < m; ++j)
         {
-          /* TODO: Implement realloc in arena. */
-          memcpy (newarr, da->data, da->capacity * da->data_size);
-          arfree (da->data);
+          int key = keys[i + j];
+          out[i + j] = _clomy_htgeth (ht, (U64)key, hash[j]);
         }
     }
-  else
+}
+
+int
+clomy_htput_batch (clomy_ht *ht, const int *keys, size_t n,
+                           const void *values)
+{
+  const U8 *value = values;
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
+  void *slot;
+
+  for (i = 0; i < n; i += m)
     {
-      newarr = realloc (da->data, capacity * da->data_size);
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_hthashbatch (ht, keys + i, m, hash);
+
+      for (j = 0; j < m; ++j, value += ht->data_size)
+        {
+          int key = keys[i + j];
+
+#if defined(CLOMY_THREADS)
+          if (ht->flags & CLOMY_HTCONCURRENT)
+            {
+              if (clomy_htput (ht, key, (void *)value))
+                return 1;
+              continue;
+            }
+#endif /* defined(CLOMY_THREADS) */
+
+          slot = _clomy_htupserth (ht, (U64)key, hash[j], NULL);
+          if (!slot)
+            return 1;
+
+          memcpy (slot, value, ht->data_size);
+        }
     }
 
-  if (!newarr)
-    return 1;
+  return 0;
+}
+
+void
+clomy_htdel (clomy_ht *ht, int key)
+{
+  _clomy_htdel (ht, (U64)key);
+}
+
+void *
+clomy_u64upsert (clomy_ht *ht, U64 key, int *isnew)
+{
+  return _clomy_htupsert (ht, key, isnew);
+}
+
+int
+clomy_u64put (clomy_ht *ht, U64 key, void *value)
+{
+  void *slot;
+
+#if defined(CLOMY_THREADS)
+  /* Readers may be copying the old value, so put a new entry instead. */
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return !_clomy_htcput (ht, key, value, NULL);
+#endif /* defined(CLOMY_THREADS) */
+
+  slot = _clomy_htupsert (ht, key, NULL);
+  if (!slot)
+    return 1;
+
+  memcpy (slot, value, ht->data_size);
+  return 0;
+}
+
+int
+clomy_u64put_int (clomy_ht *table, U64 key, int val)
+{
+  return clomy_u64put (table, key, &val);
+}
+int
+clomy_u64put_float (clomy_ht *table, U64 key, float val)
+{
+  return clomy_u64put (table, key, &val);
+}
+int
+clomy_u64put_long (clomy_ht *table, U64 key, long val)
+{
+  return clomy_u64put (table, key, &val);
+}
+int
+clomy_u64put_double (clomy_ht *table, U64 key, double val)
+{
+  return clomy_u64put (table, key, &val);
+}
+int
+clomy_u64put_char (clomy_ht *table, U64 key, char val)
+{
+  return clomy_u64put (table, key, &val);
+}
+int
+clomy_u64put_short (clomy_ht *table, U64 key, short val)
+{
+  return clomy_u64put (table, key, &val);
+}
+/**/
+
+int
+clomy_u64inc_int (clomy_ht *ht, U64 key)
+{
+  int *ptr;
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_htcinc (ht, key);
+#endif /* defined(CLOMY_THREADS) */
 
-  da->data = newarr;
-  da->capacity = capacity;
+  ptr = _clomy_htupsert (ht, key, NULL);
+  if (!ptr)
+    return 1;
 
+  ++*ptr;
   return 0;
 }
 
 void *
-clomy_daget (clomy_da *da, size_t i)
+clomy_u64get (clomy_ht *ht, U64 key)
 {
-  return (char *)da->data + i * da->data_size;
+  return _clomy_htget (ht, key);
 }
 
-int
-clomy_daget_int (clomy_da *da, size_t i)
+int *
+clomy_u64get_int (clomy_ht *ht, U64 key)
 {
-  return *(int *)clomy_daget (da, i);
+  return (int *)_clomy_htget (ht, key);
 }
-float
-clomy_daget_float (clomy_da *da, size_t i)
+float *
+clomy_u64get_float (clomy_ht *ht, U64 key)
 {
-  return *(float *)clomy_daget (da, i);
+  return (float *)_clomy_htget (ht, key);
 }
-long
-clomy_daget_long (clomy_da *da, size_t i)
+long *
+clomy_u64get_long (clomy_ht *ht, U64 key)
 {
-  return *(long *)clomy_daget (da, i);
+  return (long *)_clomy_htget (ht, key);
 }
-double
-clomy_daget_double (clomy_da *da, size_t i)
+double *
+clomy_u64get_double (clomy_ht *ht, U64 key)
 {
-  return *(double *)clomy_daget (da, i);
+  return (double *)_clomy_htget (ht, key);
 }
-char
-clomy_daget_char (clomy_da *da, size_t i)
+char *
+clomy_u64get_char (clomy_ht *ht, U64 key)
 {
-  return *(char *)clomy_daget (da, i);
+  return (char *)_clomy_htget (ht, key);
 }
-short
-clomy_daget_short (clomy_da *da, size_t i)
+short *
+clomy_u64get_short (clomy_ht *ht, U64 key)
 {
-  return *(short *)clomy_daget (da, i);
+  return (short *)_clomy_htget (ht, key);
 }
 /**/
 
-void *
-clomy_dafirst (clomy_da *da)
+void
+_clomy_u64hashbatch (clomy_ht *ht, const U64 *keys, size_t n, U64 *hash)
 {
-  return clomy_daget (da, 0);
-}
+  size_t j;
 
-int
-clomy_dafirst_int (clomy_da *da)
-{
-  return *(int *)clomy_daget (da, 0);
-}
-float
-clomy_dafirst_float (clomy_da *da)
-{
-  return *(float *)clomy_daget (da, 0);
+  for (j = 0; j < n; ++j)
+    {
+      U64 key = keys[j];
+      hash[j] = _clomy_hash_int (ht, key);
+      _clomy_htprefetch (ht, hash[j], 0);
+    }
+
+  /* The first buckets have arrived while the others were hashed. */
+  for (j = 0; j < n; ++j)
+    _clomy_htprefetch (ht, hash[j], 1);
 }
-long
-clomy_dafirst_long (clomy_da *da)
+
+void
+clomy_u64get_batch (clomy_ht *ht, const U64 *keys, size_t n, void **out)
 {
-  return *(long *)clomy_daget (da, 0);
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
+
+  for (i = 0; i < n; i += m)
+    {
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_u64hashbatch (ht, keys + i, m, hash);
+
+      for (j = 0; j < m; ++j)
+        {
+          U64 key = keys[i + j];
+          out[i + j] = _clomy_htgeth (ht, key, hash[j]);
+        }
+    }
 }
-double
-clomy_dafirst_double (clomy_da *da)
+
+int
+clomy_u64put_batch (clomy_ht *ht, const U64 *keys, size_t n,
+                           const void *values)
 {
-  return *(double *)clomy_daget (da, 0);
+  const U8 *value = values;
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
+  void *slot;
+
+  for (i = 0; i < n; i += m)
+    {
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_u64hashbatch (ht, keys + i, m, hash);
+
+      for (j = 0; j < m; ++j, value += ht->data_size)
+        {
+          U64 key = keys[i + j];
+
+#if defined(CLOMY_THREADS)
+          if (ht->flags & CLOMY_HTCONCURRENT)
+            {
+              if (clomy_u64put (ht, key, (void *)value))
+                return 1;
+              continue;
+            }
+#endif /* defined(CLOMY_THREADS) */
+
+          slot = _clomy_htupserth (ht, key, hash[j], NULL);
+          if (!slot)
+            return 1;
+
+          memcpy (slot, value, ht->data_size);
+        }
+    }
+
+  return 0;
 }
-char
-clomy_dafirst_char (clomy_da *da)
+
+void
+clomy_u64del (clomy_ht *ht, U64 key)
 {
-  return *(char *)clomy_daget (da, 0);
+  _clomy_htdel (ht, key);
 }
-short
-clomy_dafirst_short (clomy_da *da)
+
+void
+clomy_u64fold (clomy_ht *ht)
 {
-  return *(short *)clomy_daget (da, 0);
+  clomy_htfold (ht);
 }
-/**/
 
 void *
-clomy_dalast (clomy_da *da)
+clomy_s64upsert (clomy_ht *ht, S64 key, int *isnew)
 {
-  return clomy_daget (da, da->size - 1);
+  return _clomy_htupsert (ht, (U64)key, isnew);
 }
 
 int
-clomy_dalast_int (clomy_da *da)
+clomy_s64put (clomy_ht *ht, S64 key, void *value)
 {
-  return *(int *)clomy_daget (da, da->size - 1);
+  void *slot;
+
+#if defined(CLOMY_THREADS)
+  /* Readers may be copying the old value, so put a new entry instead. */
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return !_clomy_htcput (ht, (U64)key, value, NULL);
+#endif /* defined(CLOMY_THREADS) */
+
+  slot = _clomy_htupsert (ht, (U64)key, NULL);
+  if (!slot)
+    return 1;
+
+  memcpy (slot, value, ht->data_size);
+  return 0;
 }
-float
-clomy_dalast_float (clomy_da *da)
+
+int
+clomy_s64put_int (clomy_ht *table, S64 key, int val)
 {
-  return *(float *)clomy_daget (da, da->size - 1);
+  return clomy_s64put (table, key, &val);
 }
-long
-clomy_dalast_long (clomy_da *da)
+int
+clomy_s64put_float (clomy_ht *table, S64 key, float val)
 {
-  return *(long *)clomy_daget (da, da->size - 1);
+  return clomy_s64put (table, key, &val);
 }
-double
-clomy_dalast_double (clomy_da *da)
+int
+clomy_s64put_long (clomy_ht *table, S64 key, long val)
 {
-  return *(double *)clomy_daget (da, da->size - 1);
+  return clomy_s64put (table, key, &val);
 }
-char
-clomy_dalast_char (clomy_da *da)
+int
+clomy_s64put_double (clomy_ht *table, S64 key, double val)
 {
-  return *(char *)clomy_daget (da, da->size - 1);
+  return clomy_s64put (table, key, &val);
 }
-short
-clomy_dalast_short (clomy_da *da)
+int
+clomy_s64put_char (clomy_ht *table, S64 key, char val)
 {
-  return *(short *)clomy_daget (da, da->size - 1);
+  return clomy_s64put (table, key, &val);
 }
-/**/
-
 int
-clomy_dagrow (clomy_da *da)
+clomy_s64put_short (clomy_ht *table, S64 key, short val)
 {
-  if (da->size + 1 > da->capacity)
-    return clomy_dacap (da, da->capacity * 2);
-  return 0;
+  return clomy_s64put (table, key, &val);
 }
+/**/
 
 int
-clomy_daappend (clomy_da *da, void *data)
+clomy_s64inc_int (clomy_ht *ht, S64 key)
 {
-  if (clomy_dagrow (da))
-    return 1;
+  int *ptr;
 
-  memcpy ((char *)da->data + da->size * da->data_size, data, da->data_size);
-  ++da->size;
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_htcinc (ht, (U64)key);
+#endif /* defined(CLOMY_THREADS) */
 
+  ptr = _clomy_htupsert (ht, (U64)key, NULL);
+  if (!ptr)
+    return 1;
+
+  ++*ptr;
   return 0;
 }
 
-int
-clomy_daappend_int (clomy_da *da, int data)
+void *
+clomy_s64get (clomy_ht *ht, S64 key)
 {
-  return clomy_daappend (da, &data);
+  return _clomy_htget (ht, (U64)key);
 }
-int
-clomy_daappend_float (clomy_da *da, float data)
+
+int *
+clomy_s64get_int (clomy_ht *ht, S64 key)
 {
-  return clomy_daappend (da, &data);
+  return (int *)_clomy_htget (ht, (U64)key);
 }
-int
-clomy_daappend_long (clomy_da *da, long data)
+float *
+clomy_s64get_float (clomy_ht *ht, S64 key)
 {
-  return clomy_daappend (da, &data);
+  return (float *)_clomy_htget (ht, (U64)key);
 }
-int
-clomy_daappend_double (clomy_da *da, double data)
+long *
+clomy_s64get_long (clomy_ht *ht, S64 key)
 {
-  return clomy_daappend (da, &data);
+  return (long *)_clomy_htget (ht, (U64)key);
 }
-int
-clomy_daappend_char (clomy_da *da, char data)
+double *
+clomy_s64get_double (clomy_ht *ht, S64 key)
 {
-  return clomy_daappend (da, &data);
+  return (double *)_clomy_htget (ht, (U64)key);
 }
-int
-clomy_daappend_short (clomy_da *da, short data)
+char *
+clomy_s64get_char (clomy_ht *ht, S64 key)
 {
-  return clomy_daappend (da, &data);
+  return (char *)_clomy_htget (ht, (U64)key);
+}
+short *
+clomy_s64get_short (clomy_ht *ht, S64 key)
+{
+  return (short *)_clomy_htget (ht, (U64)key);
 }
 /**/
 
-int
-clomy_dapush (clomy_da *da, void *data)
+void
+_clomy_s64hashbatch (clomy_ht *ht, const S64 *keys, size_t n, U64 *hash)
 {
-  if (clomy_dagrow (da))
-    return 1;
+  size_t j;
 
-  memmove ((char *)da->data + da->data_size, da->data,
-           da->size * da->data_size);
-  memcpy ((char *)da->data, data, da->data_size);
-  ++da->size;
+  for (j = 0; j < n; ++j)
+    {
+      S64 key = keys[j];
+      hash[j] = _clomy_hash_int (ht, (U64)key);
+      _clomy_htprefetch (ht, hash[j], 0);
+    }
 
-  return 0;
+  /* The first buckets have arrived while the others were hashed. */
+  for (j = 0; j < n; ++j)
+    _clomy_htprefetch (ht, hash[j], 1);
 }
 
-int
-clomy_dapush_int (clomy_da *da, int data)
-{
-  return clomy_dapush (da, &(int){ data });
-}
-int
-clomy_dapush_float (clomy_da *da, float data)
+void
+clomy_s64get_batch (clomy_ht *ht, const S64 *keys, size_t n, void **out)
 {
-  return clomy_dapush (da, &(float){ data });
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
+
+  for (i = 0; i < n; i += m)
+    {
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_s64hashbatch (ht, keys + i, m, hash);
+
+      for (j = 0; j < m; ++j)
+        {
+          S64 key = keys[i + j];
+          out[i + j] = _clomy_htgeth (ht, (U64)key, hash[j]);
+        }
+    }
 }
+
 int
-clomy_dapush_long (clomy_da *da, long data)
+clomy_s64put_batch (clomy_ht *ht, const S64 *keys, size_t n,
+                           const void *values)
 {
-  return clomy_dapush (da, &(long){ data });
+  const U8 *value = values;
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
+  void *slot;
+
+  for (i = 0; i < n; i += m)
+    {
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_s64hashbatch (ht, keys + i, m, hash);
+
+      for (j = 0; j < m; ++j, value += ht->data_size)
+        {
+          S64 key = keys[i + j];
+
+#if defined(CLOMY_THREADS)
+          if (ht->flags & CLOMY_HTCONCURRENT)
+            {
+              if (clomy_s64put (ht, key, (void *)value))
+                return 1;
+              continue;
+            }
+#endif /* defined(CLOMY_THREADS) */
+
+          slot = _clomy_htupserth (ht, (U64)key, hash[j], NULL);
+          if (!slot)
+            return 1;
+
+          memcpy (slot, value, ht->data_size);
+        }
+    }
+
+  return 0;
 }
-int
-clomy_dapush_double (clomy_da *da, double data)
+
+void
+clomy_s64del (clomy_ht *ht, S64 key)
 {
-  return clomy_dapush (da, &(double){ data });
+  _clomy_htdel (ht, (U64)key);
 }
-int
-clomy_dapush_char (clomy_da *da, char data)
+
+void
+clomy_s64fold (clomy_ht *ht)
 {
-  return clomy_dapush (da, &(char){ data });
+  clomy_htfold (ht);
 }
-int
-clomy_dapush_short (clomy_da *da, short data)
+
+void *
+clomy_stupsert (clomy_ht *ht, char *key, int *isnew)
 {
-  return clomy_dapush (da, &(short){ data });
+  return _clomy_stupsert (ht, key, strlen (key), isnew);
 }
-/**/
 
 int
-clomy_dainsert (clomy_da *da, size_t i, void *data)
+clomy_stput (clomy_ht *ht, char *key, void *value)
 {
-  void *pos;
+  void *slot;
 
-  if (i > da->size)
-    return 1;
+#if defined(CLOMY_THREADS)
+  /* Readers may be copying the old value, so put a new entry instead. */
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return !_clomy_stcput (ht, key, strlen (key), value, NULL);
+#endif /* defined(CLOMY_THREADS) */
 
-  if (clomy_dagrow (da))
+  slot = _clomy_stupsert (ht, key, strlen (key), NULL);
+  if (!slot)
     return 1;
 
-  pos = (char *)da->data + i * da->data_size;
-  memmove ((char *)pos + da->data_size, pos, (da->size - i) * da->data_size);
-  memcpy ((char *)pos, data, da->data_size);
-  ++da->size;
-
+  memcpy (slot, value, ht->data_size);
   return 0;
 }
 
 int
-clomy_dainsert_int (clomy_da *da, size_t i, int data)
+clomy_stput_int (clomy_ht *table, char *key, int val)
 {
-  return clomy_dainsert (da, i, &(int){ data });
+  return clomy_stput (table, key, &val);
 }
 int
-clomy_dainsert_float (clomy_da *da, size_t i, float data)
+clomy_stput_float (clomy_ht *table, char *key, float val)
 {
-  return clomy_dainsert (da, i, &(float){ data });
+  return clomy_stput (table, key, &val);
 }
 int
-clomy_dainsert_long (clomy_da *da, size_t i, long data)
+clomy_stput_long (clomy_ht *table, char *key, long val)
 {
-  return clomy_dainsert (da, i, &(long){ data });
+  return clomy_stput (table, key, &val);
 }
 int
-clomy_dainsert_double (clomy_da *da, size_t i, double data)
+clomy_stput_double (clomy_ht *table, char *key, double val)
 {
-  return clomy_dainsert (da, i, &(double){ data });
+  return clomy_stput (table, key, &val);
 }
 int
-clomy_dainsert_char (clomy_da *da, size_t i, char data)
+clomy_stput_char (clomy_ht *table, char *key, char val)
 {
-  return clomy_dainsert (da, i, &(char){ data });
+  return clomy_stput (table, key, &val);
 }
 int
-clomy_dainsert_short (clomy_da *da, size_t i, short data)
+clomy_stput_short (clomy_ht *table, char *key, short val)
 {
-  return clomy_dainsert (da, i, &(short){ data });
+  return clomy_stput (table, key, &val);
 }
 /**/
 
-void
-clomy_dadel (clomy_da *da, size_t i)
+int
+clomy_stinc_int (clomy_ht *ht, char *key)
 {
-  void *pos = (char *)da->data + i * da->data_size;
-  memmove (pos, (char *)pos + da->data_size,
-           da->size * da->data_size - i * da->data_size);
-  --da->size;
+  int *ptr;
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_stcinc (ht, key, strlen (key));
+#endif /* defined(CLOMY_THREADS) */
+
+  ptr = _clomy_stupsert (ht, key, strlen (key), NULL);
+  if (!ptr)
+    return 1;
+
+  ++*ptr;
+  return 0;
 }
 
 void *
-clomy_dapop (clomy_da *da)
+clomy_stget (clomy_ht *ht, char *key)
 {
-  void *data = aralloc (da->ar, da->data_size);
-  memcpy (data, clomy_daget (da, 0), da->data_size);
-  clomy_dadel (da, 0);
-  return data;
+  return _clomy_stget (ht, key, strlen (key));
 }
 
-int
-clomy_dapop_int (clomy_da *da)
+int *
+clomy_stget_int (clomy_ht *ht, char *key)
 {
-  return *(int *)clomy_dapop (da);
+  return (int *)_clomy_stget (ht, key, strlen (key));
 }
-float
-clomy_dapop_float (clomy_da *da)
+float *
+clomy_stget_float (clomy_ht *ht, char *key)
 {
-  return *(float *)clomy_dapop (da);
+  return (float *)_clomy_stget (ht, key, strlen (key));
 }
-long
-clomy_dapop_long (clomy_da *da)
+long *
+clomy_stget_long (clomy_ht *ht, char *key)
 {
-  return *(long *)clomy_dapop (da);
+  return (long *)_clomy_stget (ht, key, strlen (key));
 }
-double
-clomy_dapop_double (clomy_da *da)
+double *
+clomy_stget_double (clomy_ht *ht, char *key)
 {
-  return *(double *)clomy_dapop (da);
+  return (double *)_clomy_stget (ht, key, strlen (key));
 }
-char
-clomy_dapop_char (clomy_da *da)
+char *
+clomy_stget_char (clomy_ht *ht, char *key)
 {
-  return *(char *)clomy_dapop (da);
+  return (char *)_clomy_stget (ht, key, strlen (key));
 }
-short
-clomy_dapop_short (clomy_da *da)
+short *
+clomy_stget_short (clomy_ht *ht, char *key)
 {
-  return *(short *)clomy_dapop (da);
+  return (short *)_clomy_stget (ht, key, strlen (key));
 }
 /**/
 
 void
-clomy_dafold (clomy_da *da)
+_clomy_sthashbatch (clomy_ht *ht, char *const *keys, size_t n, U64 *hash)
 {
-  if (da->data)
+  size_t j;
+
+  for (j = 0; j < n; ++j)
     {
-      clomy_arfree (da->data);
-      da->data = NULL;
+      char *key = keys[j];
+      hash[j] = _clomy_hash_str (ht, key, strlen (key));
+      _clomy_htprefetch (ht, hash[j], 0);
     }
-}
 
-/*----------------------------------------------------------------------*/
-
-U32
-_clomy_hash_int (clomy_ht *ht, int x)
-{
-  U32 p = ht->a ^ x;
-  return p % ht->capacity;
+  /* The first buckets have arrived while the others were hashed. */
+  for (j = 0; j < n; ++j)
+    _clomy_htprefetch (ht, hash[j], 1);
 }
 
-U32
-_clomy_hash_str (clomy_ht *ht, char *x)
+void
+clomy_stget_batch (clomy_ht *ht, char *const *keys, size_t n, void **out)
 {
-  U32 hash = ht->a;
-  int c;
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
 
-  while ((c = *x++))
-    hash = ((hash << 5) + hash) + c;
+  for (i = 0; i < n; i += m)
+    {
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_sthashbatch (ht, keys + i, m, hash);
 
-  return hash % ht->capacity;
+      for (j = 0; j < m; ++j)
+        {
+          char *key = keys[i + j];
+          out[i + j] = _clomy_stgeth (ht, key, strlen (key), hash[j]);
+        }
+    }
 }
 
 int
-clomy_htinit (clomy_ht *ht, clomy_arena *ar, size_t capacity, size_t dsize)
+clomy_stput_batch (clomy_ht *ht, char *const *keys, size_t n,
+                           const void *values)
 {
-  CLOMY_FAILFALSE (ar, "Arena is required.");
+  const U8 *value = values;
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
+  void *slot;
 
-  size_t size;
+  for (i = 0; i < n; i += m)
+    {
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_sthashbatch (ht, keys + i, m, hash);
 
-  capacity = CLOMY_ALIGN_UP (capacity, 8);
-  size = capacity * sizeof (clomy_htdata *);
-  srand ((unsigned)time (NULL));
-  ht->a = ((U32)rand () << 1) | 1;
+      for (j = 0; j < m; ++j, value += ht->data_size)
+        {
+          char *key = keys[i + j];
 
-  ht->ar = ar;
-  ht->data_size = dsize;
-  ht->size = 0;
-  ht->capacity = capacity;
-  ht->data = clomy_aralloc (ar, size);
-  if (!ht->data)
-    return 1;
+#if defined(CLOMY_THREADS)
+          if (ht->flags & CLOMY_HTCONCURRENT)
+            {
+              if (clomy_stput (ht, key, (void *)value))
+                return 1;
+              continue;
+            }
+#endif /* defined(CLOMY_THREADS) */
 
-  memset (ht->data, 0, size);
+          slot = _clomy_stupserth (ht, key, strlen (key), hash[j], NULL);
+          if (!slot)
+            return 1;
+
+          memcpy (slot, value, ht->data_size);
+        }
+    }
 
   return 0;
 }
 
-int
-clomy_htput (clomy_ht *ht, int key, void *value)
+void
+clomy_stdel (clomy_ht *ht, char *key)
 {
-  clomy_htdata *data;
-  size_t i = _clomy_hash_int (ht, key);
-  size_t size = sizeof (clomy_htdata) + ht->data_size;
+  _clomy_stdel (ht, key, strlen (key));
+}
 
-  data = clomy_aralloc (ht->ar, size);
-  if (!data)
-    return 1;
+void *
+clomy_strupsert (clomy_ht *ht, struct clomy_string *key, int *isnew)
+{
+  return _clomy_stupsert (ht, key->data, key->size, isnew);
+}
 
-  data->key = key;
-  data->next = NULL;
-  memcpy (data->data, value, ht->data_size);
+int
+clomy_strput (clomy_ht *ht, struct clomy_string *key, void *value)
+{
+  void *slot;
 
-  if (!ht->data[i])
-    {
-      ht->data[i] = data;
-    }
-  else
-    {
-      data->next = ht->data[i];
-      ht->data[i] = data;
-    }
-  ++ht->size;
+#if defined(CLOMY_THREADS)
+  /* Readers may be copying the old value, so put a new entry instead. */
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return !_clomy_stcput (ht, key->data, key->size, value, NULL);
+#endif /* defined(CLOMY_THREADS) */
+
+  slot = _clomy_stupsert (ht, key->data, key->size, NULL);
+  if (!slot)
+    return 1;
 
+  memcpy (slot, value, ht->data_size);
   return 0;
 }
 
 int
-clomy_htput_int (clomy_ht *table, int key, int val)
+clomy_strput_int (clomy_ht *table, struct clomy_string *key, int val)
 {
-  return clomy_htput (table, key, &val);
+  return clomy_strput (table, key, &val);
 }
 int
-clomy_htput_float (clomy_ht *table, int key, float val)
+clomy_strput_float (clomy_ht *table, struct clomy_string *key, float val)
 {
-  return clomy_htput (table, key, &val);
+  return clomy_strput (table, key, &val);
 }
 int
-clomy_htput_long (clomy_ht *table, int key, long val)
+clomy_strput_long (clomy_ht *table, struct clomy_string *key, long val)
 {
-  return clomy_htput (table, key, &val);
+  return clomy_strput (table, key, &val);
 }
 int
-clomy_htput_double (clomy_ht *table, int key, double val)
+clomy_strput_double (clomy_ht *table, struct clomy_string *key, double val)
 {
-  return clomy_htput (table, key, &val);
+  return clomy_strput (table, key, &val);
 }
 int
-clomy_htput_char (clomy_ht *table, int key, char val)
+clomy_strput_char (clomy_ht *table, struct clomy_string *key, char val)
 {
-  return clomy_htput (table, key, &val);
+  return clomy_strput (table, key, &val);
 }
 int
-clomy_htput_short (clomy_ht *table, int key, short val)
+clomy_strput_short (clomy_ht *table, struct clomy_string *key, short val)
 {
-  return clomy_htput (table, key, &val);
+  return clomy_strput (table, key, &val);
 }
 /**/
+
 int
-clomy_htinc_int (clomy_ht *ht, int key)
+clomy_strinc_int (clomy_ht *ht, struct clomy_string *key)
 {
-  int *ptr = clomy_htget (ht, key);
-  if (ptr)
-    return clomy_htput_int (ht, key, *ptr + 1);
-  else
-    return clomy_htput_int (ht, key, 1);
+  int *ptr;
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_stcinc (ht, key->data, key->size);
+#endif /* defined(CLOMY_THREADS) */
+
+  ptr = _clomy_stupsert (ht, key->data, key->size, NULL);
+  if (!ptr)
+    return 1;
+
+  ++*ptr;
+  return 0;
 }
-/**/
 
-int
-clomy_stput_int (clomy_ht *table, char *key, int val)
+void *
+clomy_strget (clomy_ht *ht, struct clomy_string *key)
 {
-  return clomy_stput (table, key, &val);
+  return _clomy_stget (ht, key->data, key->size);
 }
-int
-clomy_stput_float (clomy_ht *table, char *key, float val)
+
+int *
+clomy_strget_int (clomy_ht *ht, struct clomy_string *key)
 {
-  return clomy_stput (table, key, &val);
+  return (int *)_clomy_stget (ht, key->data, key->size);
 }
-int
-clomy_stput_long (clomy_ht *table, char *key, long val)
+float *
+clomy_strget_float (clomy_ht *ht, struct clomy_string *key)
 {
-  return clomy_stput (table, key, &val);
+  return (float *)_clomy_stget (ht, key->data, key->size);
 }
-int
-clomy_stput_double (clomy_ht *table, char *key, double val)
+long *
+clomy_strget_long (clomy_ht *ht, struct clomy_string *key)
 {
-  return clomy_stput (table, key, &val);
+  return (long *)_clomy_stget (ht, key->data, key->size);
 }
-int
-clomy_stput_char (clomy_ht *table, char *key, char val)
+double *
+clomy_strget_double (clomy_ht *ht, struct clomy_string *key)
 {
-  return clomy_stput (table, key, &val);
+  return (double *)_clomy_stget (ht, key->data, key->size);
 }
-int
-clomy_stput_short (clomy_ht *table, char *key, short val)
+char *
+clomy_strget_char (clomy_ht *ht, struct clomy_string *key)
 {
-  return clomy_stput (table, key, &val);
+  return (char *)_clomy_stget (ht, key->data, key->size);
 }
-/**/
-int
-clomy_stinc_int (clomy_ht *st, char *key)
+short *
+clomy_strget_short (clomy_ht *ht, struct clomy_string *key)
 {
-  int *ptr = clomy_stget (st, key);
-  if (ptr)
-    return clomy_stput_int (st, key, *ptr + 1);
-  else
-    return clomy_stput_int (st, key, 1);
+  return (short *)_clomy_stget (ht, key->data, key->size);
 }
 /**/
-int
-clomy_stput (clomy_ht *ht, char *key, void *value)
+
+void
+_clomy_strhashbatch (clomy_ht *ht, struct clomy_string *const *keys, size_t n, U64 *hash)
 {
-  clomy_stdata *data;
-  size_t i = _clomy_hash_str (ht, key);
-  size_t size = sizeof (clomy_stdata) + ht->data_size, keylen = strlen (key);
+  size_t j;
 
-  data = clomy_aralloc (ht->ar, size);
-  if (!data)
-    return 1;
+  for (j = 0; j < n; ++j)
+    {
+      struct clomy_string *key = keys[j];
+      hash[j] = _clomy_hash_str (ht, key->data, key->size);
+      _clomy_htprefetch (ht, hash[j], 0);
+    }
 
-  data->key = clomy_aralloc (ht->ar, keylen + 1);
-  if (!data->key)
-    return 1;
+  /* The first buckets have arrived while the others were hashed. */
+  for (j = 0; j < n; ++j)
+    _clomy_htprefetch (ht, hash[j], 1);
+}
 
-  CLOMY_strcpy (data->key, key, keylen);
-  data->next = NULL;
-  memcpy (data->data, value, ht->data_size);
+void
+clomy_strget_batch (clomy_ht *ht, struct clomy_string *const *keys, size_t n, void **out)
+{
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
 
-  if (!ht->data[i])
+  for (i = 0; i < n; i += m)
     {
-      ht->data[i] = data;
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_strhashbatch (ht, keys + i, m, hash);
+
+      for (j = 0; j < m; ++j)
+        {
+          struct clomy_string *key = keys[i + j];
+          out[i + j] = _clomy_stgeth (ht, key->data, key->size, hash[j]);
+        }
     }
-  else
+}
+
+int
+clomy_strput_batch (clomy_ht *ht, struct clomy_string *const *keys, size_t n,
+                           const void *values)
+{
+  const U8 *value = values;
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
+  void *slot;
+
+  for (i = 0; i < n; i += m)
     {
-      data->next = ht->data[i];
-      ht->data[i] = data;
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_strhashbatch (ht, keys + i, m, hash);
+
+      for (j = 0; j < m; ++j, value += ht->data_size)
+        {
+          struct clomy_string *key = keys[i + j];
+
+#if defined(CLOMY_THREADS)
+          if (ht->flags & CLOMY_HTCONCURRENT)
+            {
+              if (clomy_strput (ht, key, (void *)value))
+                return 1;
+              continue;
+            }
+#endif /* defined(CLOMY_THREADS) */
+
+          slot = _clomy_stupserth (ht, key->data, key->size, hash[j], NULL);
+          if (!slot)
+            return 1;
+
+          memcpy (slot, value, ht->data_size);
+        }
     }
-  ++ht->size;
 
   return 0;
 }
 
-void *
-clomy_htget (clomy_ht *ht, int key)
+void
+clomy_strdel (clomy_ht *ht, struct clomy_string *key)
 {
-  clomy_htdata *ptr;
-  size_t i = _clomy_hash_int (ht, key);
-
-  ptr = ht->data[i];
-  if (!ptr)
-    return NULL;
-
-  while (ptr)
-    {
-      if (ptr->key == key)
-        return ptr->data;
-      ptr = ptr->next;
-    }
+  _clomy_stdel (ht, key->data, key->size);
+}
 
-  return NULL;
+void
+clomy_strfold (clomy_ht *ht)
+{
+  clomy_stfold (ht);
 }
 
 void *
-clomy_stget (clomy_ht *ht, char *key)
+clomy_btupsert (clomy_ht *ht, const void *key, int *isnew)
 {
-  clomy_stdata *ptr;
+  return _clomy_stupsert (ht, key, ht->key_size, isnew);
+}
 
-  size_t i = _clomy_hash_str (ht, key);
+int
+clomy_btput (clomy_ht *ht, const void *key, void *value)
+{
+  void *slot;
 
-  ptr = ht->data[i];
-  if (!ptr)
-    return NULL;
+#if defined(CLOMY_THREADS)
+  /* Readers may be copying the old value, so put a new entry instead. */
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return !_clomy_stcput (ht, key, ht->key_size, value, NULL);
+#endif /* defined(CLOMY_THREADS) */
 
-  while (ptr)
-    {
-      if (strcmp (ptr->key, key) == 0)
-        return ptr->data;
-      ptr = ptr->next;
-    }
+  slot = _clomy_stupsert (ht, key, ht->key_size, NULL);
+  if (!slot)
+    return 1;
 
-  return NULL;
+  memcpy (slot, value, ht->data_size);
+  return 0;
 }
 
-int *
-clomy_htget_int (clomy_ht *ht, int key)
+int
+clomy_btput_int (clomy_ht *table, const void *key, int val)
 {
-  return (int *)clomy_htget (ht, key);
+  return clomy_btput (table, key, &val);
 }
-float *
-clomy_htget_float (clomy_ht *ht, int key)
+int
+clomy_btput_float (clomy_ht *table, const void *key, float val)
 {
-  return (float *)clomy_htget (ht, key);
+  return clomy_btput (table, key, &val);
 }
-long *
-clomy_htget_long (clomy_ht *ht, int key)
+int
+clomy_btput_long (clomy_ht *table, const void *key, long val)
 {
-  return (long *)clomy_htget (ht, key);
+  return clomy_btput (table, key, &val);
 }
-double *
-clomy_htget_double (clomy_ht *ht, int key)
+int
+clomy_btput_double (clomy_ht *table, const void *key, double val)
 {
-  return (double *)clomy_htget (ht, key);
+  return clomy_btput (table, key, &val);
 }
-char *
-clomy_htget_char (clomy_ht *ht, int key)
+int
+clomy_btput_char (clomy_ht *table, const void *key, char val)
 {
-  return (char *)clomy_htget (ht, key);
+  return clomy_btput (table, key, &val);
 }
-short *
-clomy_htget_short (clomy_ht *ht, int key)
+int
+clomy_btput_short (clomy_ht *table, const void *key, short val)
+{
+  return clomy_btput (table, key, &val);
+}
+/**/
+
+int
+clomy_btinc_int (clomy_ht *ht, const void *key)
+{
+  int *ptr;
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    return _clomy_stcinc (ht, key, ht->key_size);
+#endif /* defined(CLOMY_THREADS) */
+
+  ptr = _clomy_stupsert (ht, key, ht->key_size, NULL);
+  if (!ptr)
+    return 1;
+
+  ++*ptr;
+  return 0;
+}
+
+void *
+clomy_btget (clomy_ht *ht, const void *key)
 {
-  return (short *)clomy_htget (ht, key);
+  return _clomy_stget (ht, key, ht->key_size);
 }
 
 int *
-clomy_stget_int (clomy_ht *st, char *key)
+clomy_btget_int (clomy_ht *ht, const void *key)
 {
-  return (int *)clomy_stget (st, key);
+  return (int *)_clomy_stget (ht, key, ht->key_size);
 }
 float *
-clomy_stget_float (clomy_ht *st, char *key)
+clomy_btget_float (clomy_ht *ht, const void *key)
 {
-  return (float *)clomy_stget (st, key);
+  return (float *)_clomy_stget (ht, key, ht->key_size);
 }
 long *
-clomy_stget_long (clomy_ht *st, char *key)
+clomy_btget_long (clomy_ht *ht, const void *key)
 {
-  return (long *)clomy_stget (st, key);
+  return (long *)_clomy_stget (ht, key, ht->key_size);
 }
 double *
-clomy_stget_double (clomy_ht *st, char *key)
+clomy_btget_double (clomy_ht *ht, const void *key)
 {
-  return (double *)clomy_stget (st, key);
+  return (double *)_clomy_stget (ht, key, ht->key_size);
 }
 char *
-clomy_stget_char (clomy_ht *st, char *key)
+clomy_btget_char (clomy_ht *ht, const void *key)
 {
-  return (char *)clomy_stget (st, key);
+  return (char *)_clomy_stget (ht, key, ht->key_size);
 }
 short *
-clomy_stget_short (clomy_ht *st, char *key)
+clomy_btget_short (clomy_ht *ht, const void *key)
 {
-  return (short *)clomy_stget (st, key);
+  return (short *)_clomy_stget (ht, key, ht->key_size);
 }
 /**/
 
 void
-clomy_htdel (clomy_ht *ht, int key)
+_clomy_bthashbatch (clomy_ht *ht, const void *const *keys, size_t n, U64 *hash)
 {
-  clomy_htdata *ptr, *prev = NULL;
-  size_t i = _clomy_hash_int (ht, key);
-
-  ptr = ht->data[i];
+  size_t j;
 
-  while (ptr)
+  for (j = 0; j < n; ++j)
     {
-      if (ptr->key == key)
-        {
-          if (prev)
-            prev->next = ptr->next;
+      const void *key = keys[j];
+      hash[j] = _clomy_hash_str (ht, key, ht->key_size);
+      _clomy_htprefetch (ht, hash[j], 0);
+    }
 
-          arfree (ptr);
+  /* The first buckets have arrived while the others were hashed. */
+  for (j = 0; j < n; ++j)
+    _clomy_htprefetch (ht, hash[j], 1);
+}
 
-          if (!prev)
-            ht->data[i] = ptr->next;
+void
+clomy_btget_batch (clomy_ht *ht, const void *const *keys, size_t n, void **out)
+{
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
 
-          --ht->size;
-          break;
-        }
+  for (i = 0; i < n; i += m)
+    {
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_bthashbatch (ht, keys + i, m, hash);
 
-      prev = ptr;
-      ptr = ptr->next;
+      for (j = 0; j < m; ++j)
+        {
+          const void *key = keys[i + j];
+          out[i + j] = _clomy_stgeth (ht, key, ht->key_size, hash[j]);
+        }
     }
 }
 
-void
-clomy_stdel (clomy_ht *ht, char *key)
+int
+clomy_btput_batch (clomy_ht *ht, const void *const *keys, size_t n,
+                           const void *values)
 {
-  clomy_stdata *ptr, *prev = NULL;
-  size_t i = _clomy_hash_str (ht, key);
-
-  ptr = ht->data[i];
+  const U8 *value = values;
+  U64 hash[CLOMY_HASHTABLE_BATCH];
+  size_t i, j, m;
+  void *slot;
 
-  while (ptr)
+  for (i = 0; i < n; i += m)
     {
-      if (strcmp (ptr->key, key) == 0)
+      m = n - i < CLOMY_HASHTABLE_BATCH ? n - i : CLOMY_HASHTABLE_BATCH;
+      _clomy_bthashbatch (ht, keys + i, m, hash);
+
+      for (j = 0; j < m; ++j, value += ht->data_size)
         {
-          if (prev)
-            prev->next = ptr->next;
+          const void *key = keys[i + j];
 
-          arfree (ptr->key);
-          arfree (ptr);
+#if defined(CLOMY_THREADS)
+          if (ht->flags & CLOMY_HTCONCURRENT)
+            {
+              if (clomy_btput (ht, key, (void *)value))
+                return 1;
+              continue;
+            }
+#endif /* defined(CLOMY_THREADS) */
 
-          if (!prev)
-            ht->data[i] = NULL;
+          slot = _clomy_stupserth (ht, key, ht->key_size, hash[j], NULL);
+          if (!slot)
+            return 1;
 
-          --ht->size;
-          break;
+          memcpy (slot, value, ht->data_size);
         }
-
-      prev = ptr;
-      ptr = ptr->next;
     }
+
+  return 0;
+}
+
+void
+clomy_btdel (clomy_ht *ht, const void *key)
+{
+  _clomy_stdel (ht, key, ht->key_size);
+}
+
+void
+clomy_btfold (clomy_ht *ht)
+{
+  clomy_stfold (ht);
 }
 
 void
@@ -1576,20 +6976,45 @@ clomy_htfold (clomy_ht *ht)
   clomy_htdata *ptr, *next;
   size_t i;
 
-  for (i = 0; i < ht->capacity; ++i)
+  /* Open tables are a single allocation. */
+  if (ht->flags & CLOMY_HTOPEN)
+    {
+      _clomy_arrelease (ht->ar, ht->data);
+      ht->data = NULL;
+      ht->ctrl = NULL;
+      ht->size = 0;
+      return;
+    }
+
+  for (i = 0; i < ht->capacity + ht->oldcap; ++i)
     {
-      ptr = ht->data[i];
+      ptr = i < ht->capacity ? ht->data[i] : ht->old[i - ht->capacity];
 
       while (ptr)
         {
           next = ptr->next;
-          arfree (ptr);
+          _clomy_htfree (ht, ptr);
           --ht->size;
           ptr = next;
         }
     }
 
-  arfree (ht->data);
+  if (ht->flags & CLOMY_HTPOOL)
+    clomy_poolfold (&ht->nodes);
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    _clomy_htcfold (ht);
+#endif /* defined(CLOMY_THREADS) */
+
+  _clomy_arrelease (ht->ar, ht->entries);
+  _clomy_arrelease (ht->ar, ht->old);
+  _clomy_arrelease (ht->ar, ht->data);
+  ht->entries = NULL;
+  ht->used = 0;
+  ht->room = 0;
+  ht->old = NULL;
+  ht->oldcap = 0;
 }
 
 void
@@ -1598,21 +7023,35 @@ clomy_stfold (clomy_ht *ht)
   clomy_stdata *ptr, *next;
   size_t i;
 
-  for (i = 0; i < ht->capacity; ++i)
+  for (i = 0; i < ht->capacity + ht->oldcap; ++i)
     {
-      ptr = ht->data[i];
+      ptr = i < ht->capacity ? ht->data[i] : ht->old[i - ht->capacity];
 
       while (ptr)
         {
           next = ptr->next;
-          arfree (ptr->key);
-          arfree (ptr);
+          _clomy_stfree (ht, ptr);
           --ht->size;
           ptr = next;
         }
     }
 
-  arfree (ht->data);
+  if (ht->flags & CLOMY_HTPOOL)
+    clomy_poolfold (&ht->nodes);
+
+#if defined(CLOMY_THREADS)
+  if (ht->flags & CLOMY_HTCONCURRENT)
+    _clomy_htcfold (ht);
+#endif /* defined(CLOMY_THREADS) */
+
+  _clomy_arrelease (ht->ar, ht->entries);
+  _clomy_arrelease (ht->ar, ht->old);
+  _clomy_arrelease (ht->ar, ht->data);
+  ht->entries = NULL;
+  ht->used = 0;
+  ht->room = 0;
+  ht->old = NULL;
+  ht->oldcap = 0;
 }
 
 /*----------------------------------------------------------------------*/
@@ -1632,6 +7071,7 @@ clomy_stringnew (clomy_arena *ar, const char *s)
     return NULL;
 
   CLOMY_strcpy (new->data, s, new->size);
+  new->data[new->size] = '\0';
 
   return new;
 }
@@ -1644,9 +7084,12 @@ clomy_stringcpy (clomy_string *s)
     return NULL;
 
   str->data = clomy_aralloc (s->ar, s->size + 1);
+  if (!str->data)
+    return NULL;
+
   str->ar = s->ar;
   str->size = s->size;
-  CLOMY_strcpy (str->data, s->data, str->size);
+  memcpy (str->data, s->data, str->size + 1);
   return str;
 }
 
@@ -1710,9 +7153,9 @@ clomy_string_trim (clomy_string *s)
 {
   size_t a = 0, b = s->size - 1;
 
-  while (isspace ((U8)s->data[a]))
+  while (isspace ((U8) s->data[a]))
     ++a;
-  while (b > a && isspace ((U8)s->data[b]))
+  while (b > a && isspace ((U8) s->data[b]))
     --b;
 
   if (a > 0 || b < s->size)
@@ -1725,8 +7168,8 @@ clomy_string_trim (clomy_string *s)
 void
 clomy_stringfold (clomy_string *s)
 {
-  arfree (s->data);
-  arfree (s);
+  _clomy_arrelease (s->ar, s->data);
+  _clomy_arrelease (s->ar, s);
 }
 
 /*----------------------------------------------------------------------*/
@@ -1747,6 +7190,21 @@ _clomy_newsbchunk (clomy_stringbuilder *sb, size_t capacity)
   return cnk;
 }
 
+int
+_clomy_sbextend (clomy_stringbuilder *sb, clomy_sbchunk *cnk)
+{
+  size_t capacity = cnk->capacity < CLOMY_STRINGBUILDER_CAPACITY
+                        ? CLOMY_STRINGBUILDER_CAPACITY
+                        : cnk->capacity * 2;
+
+  if (clomy_arextend (sb->ar, cnk, sizeof (clomy_sbchunk) + cnk->capacity,
+                      sizeof (clomy_sbchunk) + capacity))
+    return 1;
+
+  cnk->capacity = capacity;
+  return 0;
+}
+
 void
 clomy_sbinit (clomy_stringbuilder *sb, clomy_arena *ar)
 {
@@ -1775,7 +7233,11 @@ clomy_sbappend (clomy_stringbuilder *sb, char *val)
     {
       if (j >= ptr->capacity)
         {
-          if (!ptr->next)
+          if (ptr->next)
+            {
+              ptr = ptr->next;
+            }
+          else if (_clomy_sbextend (sb, ptr) != 0)
             {
               ptr->next = _clomy_newsbchunk (sb, CLOMY_STRINGBUILDER_CAPACITY);
               if (!ptr->next)
@@ -1783,10 +7245,6 @@ clomy_sbappend (clomy_stringbuilder *sb, char *val)
 
               ptr = ptr->next;
             }
-          else
-            {
-              ptr = ptr->next;
-            }
 
           sb->tail = ptr;
         }
@@ -1820,7 +7278,7 @@ clomy_sbappendch (clomy_stringbuilder *sb, char val)
     }
 
   ptr = sb->tail;
-  if (ptr->size + 1 > ptr->capacity)
+  if (ptr->size + 1 > ptr->capacity && _clomy_sbextend (sb, ptr) != 0)
     {
       cnk = _clomy_newsbchunk (sb, CLOMY_STRINGBUILDER_CAPACITY);
       if (!cnk)
@@ -1844,60 +7302,54 @@ clomy_sbappendch (clomy_stringbuilder *sb, char val)
 int
 clomy_sbinsert (clomy_stringbuilder *sb, char *val, size_t i)
 {
-  clomy_sbchunk *ptr = sb->head, *prev, *cnk;
-  int index = (int)i;
-  size_t len = strlen (val), offset;
+  clomy_sbchunk *ptr = sb->head, *prev = NULL, *cnk;
+  size_t len = strlen (val);
 
-  do
-    {
-      if (index - (int)ptr->size < 0)
-        break;
+  if (i >= sb->size)
+    return clomy_sbappend (sb, val);
 
-      index -= (int)ptr->size;
+  /* Find the chunk holding the Ith character. */
+  while (i >= ptr->size)
+    {
+      i -= ptr->size;
+      prev = ptr;
       ptr = ptr->next;
     }
-  while (ptr);
 
-  if (index == 0 || !ptr->next)
+  /* Split the chunk at I. */
+  if (i > 0)
     {
-      cnk = _clomy_newsbchunk (sb, len);
+      cnk = _clomy_newsbchunk (sb, ptr->size - i);
       if (!cnk)
         return 1;
 
-      CLOMY_strcpy (cnk->data, val, len);
-      cnk->size = len;
+      memcpy (cnk->data, ptr->data + i, ptr->size - i);
+      cnk->size = ptr->size - i;
       cnk->next = ptr->next;
 
+      ptr->size = i;
       ptr->next = cnk;
-      sb->size += len;
-    }
-  else
-    {
-      prev = ptr;
-      offset = ptr->size - index;
+      if (sb->tail == ptr)
+        sb->tail = cnk;
 
-      cnk = _clomy_newsbchunk (sb, len - offset);
-      if (!cnk)
-        return 1;
-
-      CLOMY_strcpy (cnk->data, &val[offset], len - offset);
-      cnk->size = len - offset;
-      cnk->next = ptr->next;
-      ptr->next = cnk;
+      prev = ptr;
       ptr = cnk;
+    }
 
-      cnk = _clomy_newsbchunk (sb, offset);
-      if (!cnk)
-        return 1;
+  cnk = _clomy_newsbchunk (sb, len);
+  if (!cnk)
+    return 1;
 
-      CLOMY_strcpy (cnk->data, &((char *)prev->data)[index], offset);
-      cnk->size = offset;
-      cnk->next = ptr->next;
-      ptr->next = cnk;
+  memcpy (cnk->data, val, len);
+  cnk->size = len;
+  cnk->next = ptr;
 
-      CLOMY_strcpy (&((char *)prev->data)[index], val, offset);
-      sb->size += len;
-    }
+  if (prev)
+    prev->next = cnk;
+  else
+    sb->head = cnk;
+
+  sb->size += len;
 
   return 0;
 }
@@ -2028,7 +7480,7 @@ clomy_sbfold (clomy_stringbuilder *sb)
   while (ptr)
     {
       next = ptr->next;
-      clomy_arfree (ptr);
+      _clomy_arrelease (sb->ar, ptr);
       ptr = next;
     }
 
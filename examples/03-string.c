@@ -29,7 +29,7 @@ main ()
       if (ch == '{')
         dapush_char (&stack, ch);
       else
-        dapop (&stack);
+        datake (&stack, NULL);
     }
 
   if (stack.size == 0)
@@ -7,6 +7,32 @@ import jinja2
 TYPES = ["int", "float", "long", "double", "char", "short"]
 NUM_TYPES = ["int", "float", "long", "double", "short"]
 
+# Types the numeric kernels compute in, so that signed overflow wraps
+# instead of being undefined. Short operands already promote to int.
+NUM_CALC = {"int": "unsigned int", "long": "unsigned long"}
+
+# Key types of hash tables. KIND is the entry type they share, ARGS how the
+# key is passed to its functions and ARR the key array of the batch functions.
+HT_KEYS = [
+    {"name": "ht", "key": "int key", "kind": "ht", "args": "(U64)key",
+     "arr": "const int *keys"},
+    {"name": "u64", "key": "U64 key", "kind": "ht", "args": "key",
+     "arr": "const U64 *keys"},
+    {"name": "s64", "key": "S64 key", "kind": "ht", "args": "(U64)key",
+     "arr": "const S64 *keys"},
+    {"name": "st", "key": "char *key", "kind": "st",
+     "args": "key, strlen (key)", "arr": "char *const *keys"},
+    {"name": "str", "key": "struct clomy_string *key", "kind": "st",
+     "args": "key->data, key->size",
+     "arr": "struct clomy_string *const *keys"},
+    {"name": "bt", "key": "const void *key", "kind": "st",
+     "args": "key, ht->key_size", "arr": "const void *const *keys"},
+]
+
+for k in HT_KEYS:
+    k["hash"] = ("_clomy_hash_int (ht, %s)" if k["kind"] == "ht"
+                 else "_clomy_hash_str (ht, %s)") % k["args"]
+
 if len(sys.argv) < 3:
     print(f"Usage: {sys.argv[0]} <template_path> <output_path>",
           file=sys.stderr)
@@ -21,7 +47,8 @@ with open(TEMPLATE_FILE) as f:
     template_src = f.read()
 
 template = jinja2.Template(template_src)
-output = template.render(types=TYPES, num_types=NUM_TYPES)
+output = template.render(types=TYPES, num_types=NUM_TYPES, num_calc=NUM_CALC,
+                         ht_keys=HT_KEYS)
 
 with open(OUTPUT_FILE, "w") as f:
         f.write(output)
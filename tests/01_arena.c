@@ -1,11 +1,17 @@
+#define CLOMY_ARENA_STATS
 #define CLOMY_IMPLEMENTATION
 #include "../build/clomy.h"
 
 int
 main ()
 {
-  arena ar = { 0 };
-  void *buf1, *buf2, *buf3;
+  arena ar = { 0 }, bump = { .flags = CLOMY_ARBUMP };
+  arena batch = { .retain = 1024 * 1024, .highwater = 64 * 1024 };
+  archunk *cnk;
+  arpos pos;
+  arstat st;
+  void *buf1, *buf2, *buf3, *buf4, *bufs[4096];
+  clomy_arfree_block *blk;
 
   printf ("Allocating buf1 16 bytes.\n");
   buf1 = (char *)aralloc (&ar, 16);
@@ -17,18 +23,299 @@ main ()
   FAILFALSE (buf2, "buf2 not allocated.");
   printf ("buf2=%p\n", buf2);
 
+  printf ("Allocating buf3 16 bytes.\n");
+  buf3 = (char *)aralloc (&ar, 16);
+  FAILFALSE (buf3, "buf3 not allocated.");
+
   printf ("Freeing buf1...\n");
   arfree (buf1);
-  FAILFALSE (ar.head->free_list->size == 40, "buf1 didn't free.");
+  blk = ar.bins[_clomy_arbin (48)];
+  FAILFALSE (blk && blk->size == 48, "buf1 didn't free.");
 
-  printf ("Freeing buf2...\n"); arfree (buf2);
-  FAILFALSE (ar.head->free_list->size == 80, "buf2 didn't free.");
+  printf ("Freeing buf2...\n");
+  arfree (buf2);
+  FAILFALSE (!ar.bins[_clomy_arbin (48)], "buf1 didn't coalesce.");
+  blk = ar.bins[_clomy_arbin (96)];
+  FAILFALSE (blk && blk->size == 96, "buf2 didn't free.");
 
-  printf ("Allocating buf3 32 bytes.\n");
-  buf3 = (char *)aralloc (&ar, 32);
-  FAILFALSE (buf3, "buf3 not allocated.");
+  printf ("Allocating buf4 32 bytes.\n");
+  buf4 = (char *)aralloc (&ar, 32);
+  FAILFALSE (buf4 == buf1, "buf4 didn't reuse the free block.");
+
+  printf ("Freeing buf3 and buf4...\n");
+  arfree (buf3);
+  arfree (buf4);
+  FAILFALSE (ar.head->size == 0, "blocks didn't return to the chunk.");
+
+  printf ("Allocating 4096 blocks of 40 bytes.\n");
+  for (int i = 0; i < 4096; ++i)
+    {
+      bufs[i] = aralloc (&ar, 40);
+      FAILFALSE (bufs[i], "block not allocated.");
+    }
+
+  for (int i = 0; i < 4096; i += 2)
+    arfree (bufs[i]);
+
+  blk = ar.bins[_clomy_arbin (64)];
+  FAILFALSE (blk, "freed blocks not binned.");
+
+  buf1 = aralloc (&ar, 40);
+  FAILFALSE (buf1 == (char *)blk + CLOMY_ARHDR_SIZE,
+             "bin head not reused.");
+
+  arfold (&ar);
+
+  printf ("Reusing one large bin freed in mixed size order...\n");
+  buf1 = aralloc (&ar, 1100);
+  aralloc (&ar, 16);
+  buf2 = aralloc (&ar, 1500);
+  aralloc (&ar, 16);
+  buf3 = aralloc (&ar, 1200);
+  aralloc (&ar, 16);
+  FAILFALSE (_clomy_arbin (1100 + CLOMY_ARHDR_SIZE)
+                 == _clomy_arbin (1500 + CLOMY_ARHDR_SIZE),
+             "blocks not in one bin.");
+
+  arfree (buf2);
+  arfree (buf1);
+  arfree (buf3);
+
+  /* Large bins are searched first fit, the latest freed block first. */
+  FAILFALSE (aralloc (&ar, 1400) == buf2, "fitting block not reused.");
+  FAILFALSE (aralloc (&ar, 1000) == buf3, "latest freed block not reused.");
+  FAILFALSE (aralloc (&ar, 1100) == buf1, "exact block not reused.");
+  buf4 = aralloc (&ar, 1100);
+  FAILFALSE (buf4 != buf1 && buf4 != buf2 && buf4 != buf3,
+             "bin handed out a block twice.");
+
+  arfold (&ar);
+
+  printf ("Reallocating at the frontier...\n");
+  buf2 = aralloc (&ar, 64);
+  memset (buf2, 7, 64);
+  buf3 = arrealloc (&ar, buf2, 64, 512);
+  FAILFALSE (buf3 == buf2, "frontier block moved.");
+  FAILFALSE (((char *)buf3)[63] == 7, "frontier block lost data.");
+
+  printf ("Reallocating into a free neighbour...\n");
+  buf4 = aralloc (&ar, 128);
+  buf1 = aralloc (&ar, 16);
+  arfree (buf4);
+  buf4 = arrealloc (&ar, buf3, 512, 600);
+  FAILFALSE (buf4 == buf3, "block didn't grow into free neighbour.");
+
+  printf ("Reallocating by copy...\n");
+  buf3 = arrealloc (&ar, buf4, 600, 4000);
+  FAILFALSE (buf3 != buf4, "block grew over a used neighbour.");
+  FAILFALSE (((char *)buf3)[63] == 7, "moved block lost data.");
+
+  arfold (&ar);
+
+  printf ("Allocating 16 MB in 1 KB blocks...\n");
+  for (int i = 0; i < 16 * 1024; ++i)
+    FAILFALSE (aralloc (&ar, 1024), "block not allocated.");
+
+  arstats (&ar, &st);
+  printf ("%zu chunks, %zu bytes mapped.\n", st.chunks, st.mapped);
+  FAILFALSE (st.chunks < 16, "chunks didn't grow geometrically.");
+
+  printf ("Allocating a huge block...\n");
+  buf1 = aralloc (&ar, 4 * CLOMY_ARENA_HUGE_SIZE);
+  FAILFALSE (buf1, "huge block not allocated.");
+  memset (buf1, 1, 4 * CLOMY_ARENA_HUGE_SIZE);
+
+  arstats (&ar, &st);
+  FAILFALSE (st.huge_chunks == 1, "huge block not mapped on its own.");
+
+  arfree (buf1);
+  arstats (&ar, &st);
+  FAILFALSE (st.huge_chunks == 0 && st.huge_mapped == 0,
+             "huge block not unmapped.");
+
+  arfold (&ar);
+
+  printf ("Allocating aligned blocks...\n");
+  for (size_t align = 16; align <= 4096; align *= 2)
+    for (int i = 0; i < 64; ++i)
+      {
+        bufs[2 * i] = aralloc (&ar, 8 + i);
+        bufs[2 * i + 1] = aralloc_aligned (&ar, 24 + i * 8, align);
+        FAILFALSE (bufs[2 * i + 1], "aligned block not allocated.");
+        FAILFALSE ((size_t)bufs[2 * i + 1] % align == 0, "block not aligned.");
+        memset (bufs[2 * i + 1], 3, 24 + i * 8);
+        if (i % 3 == 0)
+          arfree (bufs[2 * i]);
+      }
+
+  buf1 = aralloc_aligned (&ar, 2 * CLOMY_ARENA_HUGE_SIZE, 4096);
+  FAILFALSE ((size_t)buf1 % 4096 == 0, "huge block not aligned.");
+  memset (buf1, 3, 2 * CLOMY_ARENA_HUGE_SIZE);
+  FAILFALSE (arrealloc (&ar, buf1, 2 * CLOMY_ARENA_HUGE_SIZE,
+                        3 * CLOMY_ARENA_HUGE_SIZE / 2)
+                 == buf1,
+             "huge aligned block didn't shrink in place.");
+  arfree (buf1);
 
   arfold (&ar);
+  for (int i = 0; i < 64; ++i)
+    {
+      bufs[2 * i] = aralloc (&ar, 8 + i);
+      bufs[2 * i + 1] = aralloc_aligned (&ar, 24 + i * 8, 64);
+    }
+
+  for (int i = 0; i < 128; ++i)
+    arfree (bufs[(i * 37) % 128]);
+
+  arstats (&ar, &st);
+  FAILFALSE (st.in_use == 0 && st.huge_chunks == 0,
+             "aligned blocks not given back.");
+  for (cnk = ar.head; cnk; cnk = cnk->next)
+    FAILFALSE (!cnk->size
+                   || ((clomy_arfree_block *)cnk->data)->size == cnk->size,
+               "aligned padding didn't coalesce.");
+
+  buf1 = aralloc (&bump, 8);
+  buf2 = aralloc_aligned (&bump, 40, 64);
+  FAILFALSE ((size_t)buf2 % 64 == 0, "bump block not aligned.");
+  FAILFALSE (aralloc (&bump, 8) == (char *)buf2 + 40,
+             "bump slack not given back.");
+  arfold (&bump);
+
+  arfold (&ar);
+
+  printf ("Counting arena usage...\n");
+  buf1 = aralloc (&ar, 40);
+  buf2 = aralloc (&ar, 40);
+  buf3 = aralloc (&ar, 40);
+  arfree (buf2);
+
+  arstats (&ar, &st);
+  FAILFALSE (st.in_use == 2 * 64 && st.free == 64 && st.largest_free == 64,
+             "usage not counted.");
+  FAILFALSE (st.allocs == 3 && st.frees == 1 && st.new_chunks == 1,
+             "allocations not counted.");
+  ardump (&ar, stdout);
+
+  arfree (buf1);
+  arfree (buf3);
+  arstats (&ar, &st);
+  FAILFALSE (st.in_use == 0 && st.free == 0 && st.largest_free == 0,
+             "usage not given back.");
+
+  arfold (&ar);
+
+  /* Without mmap chunks are malloced and the reserve is unused. */
+#if defined(CLOMY__MMAP)
+  arena big = { .flags = CLOMY_ARHUGEPAGE | CLOMY_ARPOPULATE,
+                .reserve = 64 * 1024 * 1024 };
+
+  printf ("Allocating 16 MB from a reserved arena...\n");
+  for (int i = 0; i < 16 * 1024; ++i)
+    FAILFALSE (aralloc (&big, 1024), "block not allocated.");
+
+  FAILFALSE ((U8 *)big.head == big.rsv, "chunk not carved from reserve.");
+  for (cnk = big.head; cnk; cnk = cnk->next)
+    {
+      FAILFALSE (cnk->flags & CLOMY_CNKRESERVED, "chunk not reserved.");
+      FAILFALSE (!cnk->next || (U8 *)cnk->next == cnk->data + cnk->capacity,
+                 "reserved chunks not contiguous.");
+    }
+
+  buf1 = aralloc (&big, 4 * CLOMY_ARENA_HUGE_SIZE);
+  FAILFALSE (buf1, "huge block not allocated.");
+  FAILFALSE ((U8 *)buf1 < big.rsv || (U8 *)buf1 >= big.rsv + big.reserve,
+             "huge block carved from reserve.");
+  arfree (buf1);
+
+  arreset (&big);
+  FAILFALSE (!big.head && big.rsvused == 0, "reserve not decommitted.");
+  FAILFALSE (aralloc (&big, 16) && (U8 *)big.head == big.rsv,
+             "reserve not reused.");
+
+  printf ("Growing a reserved arena between resets...\n");
+  arfold (&big);
+  big.retain = 64 * 1024 * 1024;
+  FAILFALSE (aralloc (&big, 6000) && aralloc (&big, 12000),
+             "block not allocated.");
+  arreset (&big);
+  FAILFALSE (aralloc (&big, 25000), "block not allocated.");
+  arreset (&big);
+  for (cnk = big.head; cnk; cnk = cnk->next)
+    FAILFALSE (cnk->data + cnk->capacity <= big.rsv + big.rsvused,
+               "reset chunk above the committed reserve.");
+
+  buf1 = aralloc (&big, 100000);
+  FAILFALSE (buf1, "block not allocated.");
+  for (cnk = big.head; cnk; cnk = cnk->next)
+    FAILFALSE (cnk == big.tail || (U8 *)buf1 < (U8 *)cnk
+                   || (U8 *)buf1 >= cnk->data + cnk->capacity,
+               "reserve handed out a kept chunk.");
+
+  arfold (&big);
+  FAILFALSE (!big.rsv, "reserve not released.");
+  FAILFALSE (aralloc (&big, 16), "reserved arena not reusable.");
+  arfold (&big);
+#endif /* defined(CLOMY__MMAP) */
+
+  printf ("Resetting an arena between batches...\n");
+  for (int round = 0; round < 3; ++round)
+    {
+      for (int i = 0; i < 512; ++i)
+        FAILFALSE (aralloc (&batch, 1024), "block not allocated.");
+
+      arstats (&batch, &st);
+      FAILFALSE (round == 0 || st.new_chunks == 0,
+                 "reset chunks not reused.");
+
+      arreset (&batch);
+      arstats (&batch, &st);
+      FAILFALSE (st.in_use == 0 && st.free == 0, "reset left memory in use.");
+      FAILFALSE (batch.head && batch.head->size == 0, "chunks not kept.");
+      batch.stat.new_chunks = 0;
+    }
+
+  for (int i = 0; i < 4 * 1024; ++i)
+    FAILFALSE (aralloc (&batch, 1024), "block not allocated.");
+
+  arreset (&batch);
+  arstats (&batch, &st);
+  FAILFALSE (st.mapped <= batch.retain, "reset kept too many chunks.");
+  arfold (&batch);
+
+  printf ("Allocating from bump arena.\n");
+  buf1 = aralloc (&bump, 16);
+  buf2 = aralloc (&bump, 16);
+  FAILFALSE ((char *)buf2 - (char *)buf1 == 16, "bump arena has a header.");
+
+  pos = armark (&bump);
+  for (int i = 0; i < 4096; ++i)
+    {
+      bufs[i] = aralloc (&bump, 40);
+      FAILFALSE (bufs[i], "block not allocated.");
+    }
+  FAILFALSE (bump.tail != bump.head, "bump arena didn't grow.");
+
+  printf ("Rewinding bump arena.\n");
+  arrewind (&bump, pos);
+  FAILFALSE (bump.tail == bump.head, "bump arena didn't rewind.");
+  FAILFALSE (aralloc (&bump, 40) == bufs[0], "rewind didn't reuse memory.");
+
+  buf3 = bump.head->next;
+  for (int i = 0; i < 4096; ++i)
+    aralloc (&bump, 40);
+  FAILFALSE (bump.head->next == buf3, "rewind didn't keep chunks.");
+
+  buf3 = aralloc (&bump, 40);
+  FAILFALSE (arrealloc (&bump, buf3, 40, 400) == buf3,
+             "bump frontier block moved.");
+  FAILFALSE (aralloc (&bump, 8) == (char *)buf3 + 400,
+             "bump frontier didn't move.");
+
+  arrewind (&bump, (arpos){ 0 });
+  FAILFALSE (aralloc (&bump, 16) == buf1, "rewind didn't reset arena.");
+
+  arfold (&bump);
 
   return 0;
 }
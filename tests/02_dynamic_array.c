@@ -7,6 +7,8 @@ typedef struct
   U32 age;
 } Person;
 
+DA_DECLARE (Person, person)
+
 inline Person *daget_person (da *people, U32 i);
 
 #define daappend_person(people, ...)                                          \
@@ -21,8 +23,12 @@ int
 main ()
 {
   arena ar = { 0 };
-  da stk = { 0 }, people = { 0 };
+  da stk = { 0 }, people = { 0 }, queue = { .flags = CLOMY_DARING };
+  da_double nums_d = { 0 };
+  clomy_da_person crew = { 0 };
+  double sum;
   Person *p;
+  int i, next = 0, nums[100];
 
   /* --------- Stack --------- */
   printf ("Initialising dynamic array (stack)...\n");
@@ -43,6 +49,123 @@ main ()
   FAILFALSE (dalast_int (&stk) == 2, "invalid stack value.");
   FAILFALSE (daget_int (&stk, 1) == 2, "invalid stack value.");
 
+  FAILFALSE (datake (&stk, &i) == 0 && i == 4, "invalid take value.");
+  FAILFALSE (datake (&stk, NULL) == 0, "take failed.");
+  FAILFALSE (stk.size == 0, "invalid stack size.");
+  FAILFALSE (datake (&stk, &i) == 1, "took from empty stack.");
+  FAILFALSE (dapop_int (&stk) == 0, "popped from empty stack.");
+
+  /* --------- Ring queue --------- */
+  printf ("Initialising dynamic array (ring queue)...\n");
+  dainit (&queue, &ar, sizeof (int), 5);
+  FAILFALSE (queue.capacity == 8, "ring capacity not a power of two.");
+
+  printf ("Queueing and popping 1000 items...\n");
+  for (i = 0; i < 1000; ++i)
+    {
+      daappend_int (&queue, i);
+      if (i % 3 == 2)
+        FAILFALSE (dapop_int (&queue) == next++, "invalid queue order.");
+    }
+
+  FAILFALSE (queue.size == (size_t)(1000 - next), "invalid queue size.");
+  FAILFALSE (queue.capacity == 1024, "queue grew past its size.");
+  FAILFALSE (dafirst_int (&queue) == next, "invalid queue front.");
+  FAILFALSE (dalast_int (&queue) == 999, "invalid queue back.");
+
+  printf ("Pushing, inserting and deleting in ring queue...\n");
+  dapush_int (&queue, -1);
+  dainsert_int (&queue, 2, -2);
+  dainsert_int (&queue, queue.size - 1, -3);
+  FAILFALSE (daget_int (&queue, 0) == -1, "invalid ring push.");
+  FAILFALSE (daget_int (&queue, 1) == next, "invalid ring insert.");
+  FAILFALSE (daget_int (&queue, 2) == -2, "invalid ring insert.");
+  FAILFALSE (daget_int (&queue, queue.size - 2) == -3, "invalid ring insert.");
+
+  dadel (&queue, queue.size - 2);
+  dadel (&queue, 2);
+  dadel (&queue, 0);
+  for (i = 0; (size_t)i < queue.size; ++i)
+    FAILFALSE (daget_int (&queue, i) == next + i, "invalid ring delete.");
+
+  while (queue.size)
+    FAILFALSE (dapop_int (&queue) == next++, "invalid queue order.");
+
+  FAILFALSE (next == 1000, "queue lost items.");
+  dafold (&queue);
+
+  /* --------- Bulk operations --------- */
+  printf ("Appending, inserting and deleting ranges...\n");
+  for (i = 0; i < 100; ++i)
+    nums[i] = i;
+
+  FAILTRUE (dareserve (&stk, 100), "reserve failed.");
+  FAILFALSE (stk.capacity == 128, "invalid reserved capacity.");
+  daappend_n (&stk, nums, 60);
+  dainsert_range (&stk, 10, nums + 60, 40);
+  dadel_range (&stk, 50, 10);
+  FAILFALSE (stk.size == 90 && stk.capacity == 128, "stack regrown.");
+  for (i = 0; i < 90; ++i)
+    FAILFALSE (daget_int (&stk, i)
+                   == (i < 10 ? i : i < 50 ? i + 50 : i - 30),
+               "invalid range value.");
+
+  daresize (&stk, 200);
+  FAILFALSE (daget_int (&stk, 89) == 59 && daget_int (&stk, 199) == 0,
+             "invalid resize.");
+  daresize (&stk, 0);
+  FAILFALSE (stk.size == 0, "invalid resize.");
+
+  printf ("Appending, inserting and deleting ranges in ring queue...\n");
+  dainit (&queue, &ar, sizeof (int), 8);
+  daappend_n (&queue, nums, 6);
+  for (i = 0; i < 4; ++i)
+    dapop_int (&queue);
+
+  /* The inserted range wraps around the end of the ring. */
+  daappend_n (&queue, nums + 6, 5);
+  dainsert_range (&queue, 1, nums + 50, 20);
+  dadel_range (&queue, 2, 4);
+  dadel_range (&queue, 18, 5);
+  FAILFALSE (queue.size == 18, "invalid ring size.");
+  for (i = 0; i < 18; ++i)
+    FAILFALSE (daget_int (&queue, i)
+                   == (i < 1 ? 4 : i < 2 ? 50 : i < 17 ? i + 53 : 5),
+               "invalid ring range value.");
+
+  daresize (&queue, 40);
+  FAILFALSE (daget_int (&queue, 17) == 5 && daget_int (&queue, 39) == 0,
+             "invalid ring resize.");
+  dafold (&queue);
+
+  /* --------- Typed dynamic array --------- */
+  printf ("Initialising typed dynamic array...\n");
+  da_double_init (&nums_d, &ar, 0);
+  for (i = 0; i < 1000; ++i)
+    FAILTRUE (da_double_append (&nums_d, i), "append failed.");
+
+  FAILFALSE (nums_d.size == 1000 && nums_d.capacity == 1024,
+             "invalid typed array size.");
+
+  da_double_insert (&nums_d, 0, -1);
+  da_double_del (&nums_d, 1);
+  da_double_append_n (&nums_d, nums_d.data, 10);
+  FAILFALSE (nums_d.size == 1010, "invalid typed array size.");
+
+  sum = 0;
+  for (i = 0; (size_t)i < nums_d.size; ++i)
+    sum += nums_d.data[i];
+
+  FAILFALSE (sum == 499500 - 1 + 44, "invalid typed array sum.");
+  da_double_fold (&nums_d);
+
+  clomy_da_person_init (&crew, &ar, 2);
+  clomy_da_person_append (&crew, (Person){ .name = "Jane doe", .age = 26 });
+  clomy_da_person_resize (&crew, 3);
+  FAILFALSE (crew.data[0].age == 26 && crew.data[2].age == 0,
+             "invalid typed person.");
+  clomy_da_person_fold (&crew);
+
   /* --------- Custom dynamic array --------- */
   printf ("Initialising dynamic array (custom)...\n");
   dainit (&people, &ar, sizeof (Person), 16);
@@ -14,9 +14,17 @@ int
 main ()
 {
   arena ar = { 0 };
-  ht strmap = { 0 }, nummap = { 0 };
+  ht strmap = { 0 }, nummap = { 0 }, openmap = { .flags = CLOMY_HTOPEN };
+  ht seeded = { .flags = CLOMY_HTSEED, .seed = 42 };
+  ht densemap = { .flags = CLOMY_HTDENSE };
   U32 i;
-  int val;
+  U64 seed;
+  int val, key, n;
+  char buf[128], *word;
+  int pt[2], keys[100], vals[100];
+  char *words[3] = { "foo", "baz", "bar" };
+  void *out[100];
+  string *s;
 
   /* --------- Hash table with stirng key --------- */
   htinit (&strmap, &ar, 8, sizeof (int));
@@ -33,6 +41,47 @@ main ()
   FAILFALSE (*stget_int (&strmap, "foobar") == 24,
              "incorrect value for FOOBAR.");
 
+  printf ("Updating values in string key table...\n");
+  stput_int (&strmap, "bar", 7);
+  for (i = 0; i < 1000; ++i)
+    stinc_int (&strmap, "count");
+
+  FAILFALSE (strmap.size == 4, "update put a new key.");
+  FAILFALSE (*stget_int (&strmap, "bar") == 7, "BAR not replaced.");
+  FAILFALSE (*stget_int (&strmap, "count") == 1000,
+             "incorrect value for COUNT.");
+
+  *(int *)stupsert (&strmap, "new", &n) += 5;
+  FAILFALSE (n, "NEW not put.");
+  *(int *)stupsert (&strmap, "new", &n) += 5;
+  FAILFALSE (!n && *stget_int (&strmap, "new") == 10,
+             "incorrect value for NEW.");
+  stdel (&strmap, "count");
+  stdel (&strmap, "new");
+
+  printf ("Hashing keys of every length...\n");
+  memset (buf, 'k', sizeof (buf));
+  for (i = 0; i < 100; ++i)
+    {
+      buf[i] = '\0';
+      stput_int (&strmap, buf, i);
+      buf[i] = 'k';
+    }
+
+  for (i = 0; i < 100; ++i)
+    {
+      buf[i] = '\0';
+      FAILFALSE (*stget_int (&strmap, buf) == (int)i,
+                 "incorrect value for long key.");
+      stdel (&strmap, buf);
+      buf[i] = 'k';
+    }
+
+  FAILFALSE (hashbytes (buf, 60, 1) == hashbytes (buf + 1, 60, 1),
+             "hash depends on alignment.");
+  FAILFALSE (hashbytes (buf, 60, 1) != hashbytes (buf, 60, 2),
+             "hash ignores seed.");
+
   printf ("Deleting value of \"foo\"...\n");
   stdel (&strmap, "foo");
   FAILFALSE (strmap.size == 2, "key FOO not deleted.");
@@ -57,9 +106,236 @@ main ()
   CHECK_NUMBER (73);
   CHECK_NUMBER (111);
 
+  printf ("Counting in U32 key table...\n");
+  for (i = 0; i < 100000; ++i)
+    htinc_int (&nummap, -(int)(i % 7));
+
+  FAILFALSE (nummap.size == 127, "increment put a key twice.");
+  FAILFALSE (*htget_int (&nummap, 0) == 100000 / 7 + 1,
+             "incorrect count for 0.");
+  FAILFALSE (*htget_int (&nummap, -6) == 100000 / 7, "incorrect count for -6.");
+
+  for (key = 0; key > -7; --key)
+    htdel (&nummap, key);
+
+  printf ("Resizing U32 key table...\n");
+  FAILFALSE (nummap.capacity >= 64, "nummap didn't grow.");
+
+  for (i = 121; i <= 5000; ++i)
+    htput (&nummap, i, &(int){ i * i });
+
+  for (i = 1; i <= 5000; ++i)
+    FAILFALSE (*htget_int (&nummap, i) == (int)(i * i),
+               "value lost while resizing.");
+
+  n = nummap.capacity;
+  for (i = 1; i <= 5000; ++i)
+    if (i % 100)
+      htdel (&nummap, i);
+
+  FAILFALSE (nummap.size == 50, "incorrect nummap size.");
+  FAILFALSE (nummap.capacity < (U32)n, "nummap didn't shrink.");
+  CHECK_NUMBER (100);
+  CHECK_NUMBER (4900);
+
+  n = 0;
+  ht_foreach (&nummap, key, {
+    FAILFALSE (key % 100 == 0, "foreach got deleted key.");
+    ++n;
+  });
+  FAILFALSE (n == 50, "foreach missed keys.");
+
+  /* The loop is a single statement, the else belongs to the if. */
+  if (n == 50)
+    ht_foreach (&nummap, key, { --n; });
+  else
+    n = -1;
+  FAILFALSE (n == 0, "foreach swallowed the else.");
+
   printf ("Folding U32 key table...\n");
   htfold (&nummap);
 
+  printf ("Seeding U32 key tables...\n");
+  seed = nummap.seed;
+  htinit (&nummap, &ar, 8, sizeof (int));
+  FAILFALSE (nummap.seed != seed, "tables at one address share a seed.");
+  htfold (&nummap);
+
+  htinit (&seeded, &ar, 8, sizeof (int));
+  htput_int (&seeded, 7, 49);
+  FAILFALSE (seeded.seed == 42, "given seed replaced.");
+  FAILFALSE (seeded.data[hashint (7, 42) & 7], "seed not used.");
+  FAILFALSE (*htget_int (&seeded, 7) == 49, "incorrect value for 7.");
+  htfold (&seeded);
+
+  /* --------- Hash table with other keys --------- */
+  htinit (&nummap, &ar, 8, sizeof (int));
+
+  printf ("Inserting in U64 key table...\n");
+  for (i = 0; i < 1000; ++i)
+    u64put_int (&nummap, ((U64)i << 40) | i, i);
+
+  s64put_int (&nummap, -1, -1);
+  FAILFALSE (nummap.size == 1001, "incorrect U64 table size.");
+  FAILFALSE (*u64get_int (&nummap, ((U64)7 << 40) | 7) == 7,
+             "incorrect value for U64 key.");
+  FAILFALSE (u64get_int (&nummap, 7) == NULL, "U64 key truncated.");
+  FAILFALSE (*s64get_int (&nummap, -1) == -1, "incorrect value for S64 key.");
+  u64fold (&nummap);
+
+  printf ("Inserting in clomy_string key table...\n");
+  htinit (&strmap, &ar, 8, sizeof (int));
+  s = stringnew (&ar, "foobar");
+  strput_int (&strmap, s, 3);
+  s->size = 3;
+  strput_int (&strmap, s, 4);
+  FAILFALSE (*stget_int (&strmap, "foobar") == 3,
+             "incorrect value for FOOBAR.");
+  FAILFALSE (*strget_int (&strmap, s) == 4, "incorrect value for FOO.");
+  strfold (&strmap);
+
+  printf ("Inserting in byte blob key table...\n");
+  btinit (&strmap, &ar, 8, sizeof (pt), sizeof (int));
+  for (i = 0; i < 100; ++i)
+    {
+      pt[0] = i;
+      pt[1] = -i;
+      btput_int (&strmap, pt, i);
+    }
+
+  pt[0] = 42;
+  pt[1] = -42;
+  FAILFALSE (*btget_int (&strmap, pt) == 42, "incorrect value for blob.");
+  pt[1] = 42;
+  FAILFALSE (btget_int (&strmap, pt) == NULL, "found missing blob.");
+  btfold (&strmap);
+
+  /* --------- Batch functions --------- */
+  htinit (&nummap, &ar, 8, sizeof (int));
+
+  printf ("Putting and getting a batch in U32 key table...\n");
+  for (i = 0; i < 100; ++i)
+    {
+      keys[i] = i * 3;
+      vals[i] = i;
+    }
+
+  FAILTRUE (htput_batch (&nummap, keys, 100, vals), "batch put failed.");
+  FAILFALSE (nummap.size == 100, "incorrect nummap size.");
+
+  keys[99] = 1;
+  htget_batch (&nummap, keys, 100, out);
+  for (i = 0; i < 99; ++i)
+    FAILFALSE (*(int *)out[i] == (int)i, "incorrect batch value.");
+
+  FAILFALSE (out[99] == NULL, "found missing key in batch.");
+  htfold (&nummap);
+
+  printf ("Getting a batch in string key table...\n");
+  htinit (&strmap, &ar, 8, sizeof (int));
+  stput_int (&strmap, "foo", 1);
+  stput_int (&strmap, "bar", 2);
+  stget_batch (&strmap, words, 3, out);
+  FAILFALSE (*(int *)out[0] == 1 && out[1] == NULL && *(int *)out[2] == 2,
+             "incorrect string batch values.");
+  stfold (&strmap);
+
+  /* --------- Dense table --------- */
+  htinit (&densemap, &ar, 8, sizeof (int));
+
+  printf ("Inserting in dense table...\n");
+  for (i = 0; i < 1000; ++i)
+    htput_int (&densemap, i * 5, i);
+
+  for (i = 0; i < 1000; i += 2)
+    htdel (&densemap, i * 5);
+
+  FAILFALSE (densemap.used == 1000, "dense deletes not left in place.");
+
+  for (i = 1000; i < 1500; ++i)
+    htput_int (&densemap, i * 5, i);
+
+  FAILFALSE (densemap.used == 1000, "dense holes not packed.");
+
+  n = 0;
+  val = 1;
+  ht_foreach (&densemap, key, {
+    FAILFALSE (key == val * 5, "dense foreach out of put order.");
+    FAILFALSE (*htget_int (&densemap, key) == val, "incorrect dense value.");
+    val += val < 999 ? 2 : 1;
+    ++n;
+  });
+  FAILFALSE (n == 1000, "dense foreach missed keys.");
+  htfold (&densemap);
+
+  printf ("Inserting in dense string key table...\n");
+  htinit (&densemap, &ar, 8, sizeof (int));
+  memset (buf, 'k', sizeof (buf));
+  for (i = 0; i < 100; ++i)
+    {
+      buf[i] = '\0';
+      stput_int (&densemap, buf, i);
+      buf[i] = 'k';
+    }
+
+  stdel (&densemap, "kkk");
+  n = 0;
+  st_foreach (&densemap, word, {
+    n += n == 3;
+    FAILFALSE (strlen (word) == (size_t)n, "dense foreach out of order.");
+    FAILFALSE (*stget_int (&densemap, word) == n, "incorrect dense value.");
+    ++n;
+  });
+  FAILFALSE (n == 100, "dense foreach missed keys.");
+  stfold (&densemap);
+
+  /* --------- Open addressing table --------- */
+  htinit (&openmap, &ar, 8, sizeof (int));
+
+  printf ("Inserting in open addressing table...\n");
+  for (i = 0; i < 10000; ++i)
+    htput_int (&openmap, i * 7, i);
+
+  FAILFALSE (openmap.size == 10000, "incorrect openmap size.");
+  FAILFALSE (openmap.capacity * 7 >= openmap.size * 8,
+             "openmap didn't grow.");
+
+  for (i = 0; i < 10000; ++i)
+    FAILFALSE (*htget_int (&openmap, i * 7) == (int)i,
+               "incorrect openmap value.");
+
+  FAILFALSE (htget_int (&openmap, 3) == NULL, "found missing key.");
+
+  printf ("Replacing and deleting in open addressing table...\n");
+  htput_int (&openmap, 14, -1);
+  FAILFALSE (*htget_int (&openmap, 14) == -1, "value not replaced.");
+
+  for (i = 0; i < 10000; i += 2)
+    htdel (&openmap, i * 7);
+
+  FAILFALSE (openmap.size == 5000, "keys not deleted.");
+  FAILFALSE (htget_int (&openmap, 14) == NULL, "key 14 not deleted.");
+
+  for (i = 0; i < 10000; i += 2)
+    htput_int (&openmap, i * 7 + 1, i);
+
+  n = 0;
+  ht_foreach (&openmap, key, {
+    FAILFALSE (*htget_int (&openmap, key) == key / 7, "foreach got bad key.");
+    ++n;
+  });
+  FAILFALSE (n == 10000, "foreach missed keys.");
+
+  for (i = 0; i < 100; ++i)
+    keys[i] = i * 7;
+
+  htget_batch (&openmap, keys, 100, out);
+  for (i = 0; i < 100; ++i)
+    FAILFALSE (i % 2 ? *(int *)out[i] == (int)i : out[i] == NULL,
+               "incorrect openmap batch value.");
+
+  htfold (&openmap);
+
   arfold (&ar);
 
   return 0;
@@ -0,0 +1,143 @@
+#define CLOMY_THREADS
+#define CLOMY_IMPLEMENTATION
+#include "../build/clomy.h"
+
+#include <threads.h>
+
+#define WORKERS 4
+#define BLOCKS 20000
+
+static arena ar = { .flags = CLOMY_ARSHARED };
+static char *blocks[2][WORKERS][BLOCKS];
+
+static int
+fill (char **bufs, size_t t)
+{
+  size_t i;
+
+  for (i = 0; i < BLOCKS; ++i)
+    {
+      bufs[i] = aralloc (&ar, 16 + i % 96);
+      if (!bufs[i])
+        return 1;
+
+      memset (bufs[i], 'a' + (int)t, 16);
+    }
+
+  return 0;
+}
+
+static int
+alloc_worker (void *arg)
+{
+  return fill (blocks[0][(size_t)arg], (size_t)arg);
+}
+
+static int
+churn_worker (void *arg)
+{
+  size_t t = (size_t)arg, i;
+
+  /* Give back the blocks of the neighbour, then reallocate our own. */
+  for (i = 0; i < BLOCKS; ++i)
+    arfree (blocks[0][(t + 1) % WORKERS][i]);
+
+  return fill (blocks[1][t], t);
+}
+
+static int
+free_one (void *arg)
+{
+  arfree (arg);
+  return 0;
+}
+
+static int
+run (thrd_start_t fn)
+{
+  thrd_t th[WORKERS];
+  size_t t;
+  int res, failed = 0;
+
+  for (t = 0; t < WORKERS; ++t)
+    if (thrd_create (&th[t], fn, (void *)t) != thrd_success)
+      return 1;
+
+  for (t = 0; t < WORKERS; ++t)
+    {
+      thrd_join (th[t], &res);
+      failed |= res;
+    }
+
+  return failed;
+}
+
+int
+main ()
+{
+  arstat st;
+  thrd_t th;
+  size_t t, i;
+  char *buf1, *buf2;
+
+  printf ("Allocating from %d threads.\n", WORKERS);
+  FAILTRUE (run (alloc_worker), "Allocation failed.");
+
+  printf ("Freeing across threads and allocating again.\n");
+  FAILTRUE (run (churn_worker), "Allocation failed.");
+
+  for (t = 0; t < WORKERS; ++t)
+    for (i = 0; i < BLOCKS; ++i)
+      FAILFALSE (blocks[1][t][i][0] == 'a' + (int)t
+                     && blocks[1][t][i][15] == 'a' + (int)t,
+                 "Block was overwritten.");
+
+  arstats (&ar, &st);
+  printf ("chunks=%zu mapped=%zu\n", st.chunks, st.mapped);
+  FAILFALSE (st.chunks >= WORKERS, "Threads should use their own chunks.");
+
+  printf ("Freeing from another thread.\n");
+  buf1 = aralloc (&ar, 64);
+  buf2 = aralloc (&ar, 64);
+  FAILFALSE (buf1 && buf2, "Allocation failed.");
+
+  thrd_create (&th, free_one, buf1);
+  thrd_join (th, NULL);
+  FAILFALSE (CLOMY__tlsheap->remote == 1, "buf1 should be queued.");
+
+  FAILFALSE (aralloc (&ar, 64) == buf1, "buf1 should be reclaimed.");
+  FAILFALSE (CLOMY__tlsheap->remote == 0, "Queue should be drained.");
+
+  thrd_create (&th, free_one, buf2);
+  thrd_join (th, NULL);
+  FAILFALSE (aralloc_aligned (&ar, 32, 64) && CLOMY__tlsheap->remote == 0,
+             "Aligned allocation should drain the queue.");
+
+  printf ("Resetting within the retain budget.\n");
+  ar.retain = 1024 * 1024;
+  arreset (&ar);
+  FAILFALSE (CLOMY__tlsheap->head && CLOMY__tlsheap->retain == ar.retain,
+             "Heap chunks should be kept.");
+
+  printf ("Resetting with a free queued from another thread.\n");
+  buf1 = aralloc (&ar, 64);
+  thrd_create (&th, free_one, buf1);
+  thrd_join (th, NULL);
+  arreset (&ar);
+  FAILFALSE (CLOMY__tlsheap->remote == 0, "Queue should be dropped.");
+
+  buf1 = aralloc (&ar, 256);
+  buf2 = aralloc (&ar, 64);
+  FAILFALSE (buf1 && buf2 && (buf2 >= buf1 + 256 || buf2 + 64 <= buf1),
+             "Reset handed out a block twice.");
+
+  arfold (&ar);
+  arstats (&ar, &st);
+  FAILFALSE (st.chunks == 0 && !ar.heaps, "Arena not folded.");
+
+  FAILFALSE (aralloc (&ar, 16), "Folded arena should be usable again.");
+  arfold (&ar);
+
+  printf ("Shared arena is working!\n");
+  return 0;
+}
@@ -0,0 +1,92 @@
+#define CLOMY_ARENA_STATS
+#define CLOMY_IMPLEMENTATION
+#include "../build/clomy.h"
+
+typedef struct
+{
+  double x, y, z;
+} Point;
+
+int
+main ()
+{
+  arena ar = { 0 };
+  pool pts = { 0 };
+  ht nummap = { .flags = CLOMY_HTPOOL }, strmap = { .flags = CLOMY_HTPOOL };
+  arstat st;
+  Point *p, *q, *all[1000];
+  int i;
+
+  /* --------- Object pool --------- */
+  printf ("Initialising pool of points...\n");
+  poolinit (&pts, &ar, sizeof (Point));
+
+  p = poolalloc (&pts);
+  q = poolalloc (&pts);
+  FAILFALSE (p && q, "point not allocated.");
+  FAILFALSE ((char *)q - (char *)p == sizeof (Point),
+             "pool object has a header.");
+
+  printf ("Reusing freed point...\n");
+  poolfree (&pts, p);
+  FAILFALSE (poolalloc (&pts) == p, "freed point not reused.");
+
+  printf ("Allocating 1000 points...\n");
+  for (i = 0; i < 1000; ++i)
+    {
+      all[i] = poolalloc (&pts);
+      FAILFALSE (all[i], "point not allocated.");
+      *all[i] = (Point){ i, i, i };
+    }
+
+  for (i = 0; i < 1000; ++i)
+    FAILFALSE (all[i]->x == i, "point overwritten.");
+
+  arstats (&ar, &st);
+  FAILFALSE (st.allocs < 10, "pool didn't allocate in slabs.");
+
+  printf ("Folding pool...\n");
+  poolfold (&pts);
+  arstats (&ar, &st);
+  FAILFALSE (st.in_use == 0, "pool slabs not freed.");
+
+  /* --------- Hash table on a pool --------- */
+  printf ("Inserting in pooled int key table...\n");
+  htinit (&nummap, &ar, 64, sizeof (int));
+  for (i = 0; i < 1000; ++i)
+    htput_int (&nummap, i, i * 2);
+
+  for (i = 0; i < 1000; i += 2)
+    htdel (&nummap, i);
+
+  FAILFALSE (nummap.size == 500, "incorrect nummap size.");
+  FAILFALSE (*htget_int (&nummap, 501) == 1002, "incorrect value for 501.");
+  FAILFALSE (htget_int (&nummap, 500) == NULL, "key 500 not deleted.");
+
+  printf ("Inserting in pooled string key table...\n");
+  htinit (&strmap, &ar, 8, sizeof (int));
+  stput_int (&strmap, "foo", 1);
+  stput_int (&strmap, "bar", 2);
+  stdel (&strmap, "foo");
+  stput_int (&strmap, "baz", 3);
+  FAILFALSE (*stget_int (&strmap, "baz") == 3, "incorrect value for BAZ.");
+  FAILFALSE (stget_int (&strmap, "foo") == NULL, "key FOO not deleted.");
+
+  printf ("Putting keys too long for the pool entry...\n");
+  stput_int (&strmap, "a key longer than the inline room", 4);
+  stput_int (&strmap, "another key longer than the inline room", 5);
+  FAILFALSE (*stget_int (&strmap, "a key longer than the inline room") == 4,
+             "incorrect value for long key.");
+  stdel (&strmap, "a key longer than the inline room");
+  FAILFALSE (*stget_int (&strmap, "baz") == 3, "incorrect value for BAZ.");
+
+  htfold (&nummap);
+  stfold (&strmap);
+
+  arstats (&ar, &st);
+  FAILFALSE (st.in_use == 0, "pooled tables not freed.");
+
+  arfold (&ar);
+
+  return 0;
+}
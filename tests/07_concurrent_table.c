@@ -0,0 +1,164 @@
+#define CLOMY_THREADS
+#define CLOMY_IMPLEMENTATION
+#include "../build/clomy.h"
+
+#include <threads.h>
+
+#define WORKERS 4
+#define KEYS 20000
+
+static arena ar = { .flags = CLOMY_ARSHARED };
+static ht nummap = { .flags = CLOMY_HTCONCURRENT };
+static ht strmap = { .flags = CLOMY_HTCONCURRENT };
+static atomic_int resets_done, late_incs;
+
+static int
+put_worker (void *arg)
+{
+  size_t t = (size_t)arg;
+  int i, ok, *val;
+
+  for (i = t; i < KEYS; i += WORKERS)
+    {
+      if (htput_int (&nummap, i, i * 2))
+        return 1;
+
+      /* Keys of the other threads are either missing or complete. */
+      htenter (&nummap);
+      val = htget_int (&nummap, (i + 1) % KEYS);
+      ok = !val || *val == ((i + 1) % KEYS) * 2;
+      htleave (&nummap);
+      if (!ok)
+        return 1;
+    }
+
+  return 0;
+}
+
+static int
+churn_worker (void *arg)
+{
+  size_t t = (size_t)arg;
+  int i, ok, *val;
+  char key[16];
+
+  for (i = 0; i < KEYS; ++i)
+    {
+      /* Each thread replaces or deletes its own keys while reading all. */
+      if (i % WORKERS == (int)t)
+        {
+          if (i % 2)
+            htdel (&nummap, i);
+          else
+            htput_int (&nummap, i, -i);
+        }
+
+      htenter (&nummap);
+      val = htget_int (&nummap, KEYS - 1 - i);
+      ok = !val || *val == (KEYS - 1 - i) * 2 || *val == -(KEYS - 1 - i);
+      htleave (&nummap);
+      if (!ok)
+        return 1;
+
+      snprintf (key, sizeof (key), "word%d", i % 100);
+      if (stinc_int (&strmap, key))
+        return 1;
+    }
+
+  return 0;
+}
+
+static int
+count_worker (void *arg)
+{
+  size_t t = (size_t)arg;
+  int i, late = 0;
+
+  for (i = 0; i < KEYS; ++i)
+    {
+      /* The first thread resets the counter while the others count. */
+      if (t == 0 && i < KEYS / 2 && i % 1000 == 0)
+        if (htput_int (&nummap, KEYS, 0))
+          return 1;
+
+      if (t == 0 && i == KEYS / 2)
+        atomic_store (&resets_done, 1);
+
+      late += atomic_load (&resets_done);
+      if (htinc_int (&nummap, KEYS))
+        return 1;
+    }
+
+  atomic_fetch_add (&late_incs, late);
+  return 0;
+}
+
+static int
+run (thrd_start_t fn)
+{
+  thrd_t th[WORKERS];
+  size_t t;
+  int res, failed = 0;
+
+  for (t = 0; t < WORKERS; ++t)
+    if (thrd_create (&th[t], fn, (void *)t) != thrd_success)
+      return 1;
+
+  for (t = 0; t < WORKERS; ++t)
+    {
+      thrd_join (th[t], &res);
+      failed |= res;
+    }
+
+  return failed;
+}
+
+int
+main ()
+{
+  int i, n;
+  char key[16];
+
+  htinit (&nummap, &ar, KEYS, sizeof (int));
+  htinit (&strmap, &ar, 128, sizeof (int));
+
+  printf ("Putting from %d threads.\n", WORKERS);
+  FAILTRUE (run (put_worker), "Put failed.");
+  FAILFALSE (nummap.size == KEYS, "incorrect nummap size.");
+
+  for (i = 0; i < KEYS; ++i)
+    FAILFALSE (*htget_int (&nummap, i) == i * 2, "incorrect value.");
+
+  printf ("Replacing, deleting and counting from %d threads.\n", WORKERS);
+  FAILTRUE (run (churn_worker), "Churn failed.");
+  FAILFALSE (nummap.size == KEYS / 2, "incorrect nummap size.");
+
+  for (i = 0; i < KEYS; i += 2)
+    {
+      FAILFALSE (*htget_int (&nummap, i) == -i, "value not replaced.");
+      FAILFALSE (htget_int (&nummap, i + 1) == NULL, "key not deleted.");
+    }
+
+  n = 0;
+  for (i = 0; i < 100; ++i)
+    {
+      snprintf (key, sizeof (key), "word%d", i);
+      n += *stget_int (&strmap, key);
+    }
+
+  FAILFALSE (n == KEYS * WORKERS, "lost increments.");
+  FAILFALSE (nummap.nretired < KEYS / 2, "deleted entries not reclaimed.");
+
+  printf ("Putting and counting the same key from %d threads.\n", WORKERS);
+  FAILTRUE (run (count_worker), "Count failed.");
+  n = *htget_int (&nummap, KEYS);
+  FAILFALSE (n >= atomic_load (&late_incs) && n <= KEYS * WORKERS,
+             "increments lost on put.");
+
+  htfold (&nummap);
+  stfold (&strmap);
+  arfold (&ar);
+
+  printf ("Concurrent table is working!\n");
+  return 0;
+}
@@ -0,0 +1,88 @@
+#define CLOMY_IMPLEMENTATION
+#include "../build/clomy.h"
+
+#define N 1003
+
+int
+main ()
+{
+  arena ar = { 0 };
+  da_double xs = { 0 }, ys = { 0 };
+  da_int ns = { 0 };
+  da_short ss = { 0 };
+  double sum = 0, dot = 0;
+  int i, isum = 0;
+
+  /* --------- Reductions --------- */
+  printf ("Reducing %d doubles...\n", N);
+  da_double_init (&xs, &ar, N);
+  da_double_init (&ys, &ar, N);
+  for (i = 0; i < N; ++i)
+    {
+      da_double_append (&xs, (i * 7) % 101 - 50.5);
+      da_double_append (&ys, 2);
+      sum += xs.data[i];
+      dot += xs.data[i] * 2;
+    }
+
+  FAILFALSE (da_double_sum (&xs) == sum, "invalid double sum.");
+  FAILFALSE (da_double_dot (&xs, &ys) == dot, "invalid double dot.");
+  FAILFALSE (da_double_min (&xs) == -50.5, "invalid double min.");
+  FAILFALSE (da_double_max (&xs) == 49.5, "invalid double max.");
+
+  printf ("Reducing %d ints...\n", N);
+  da_int_init (&ns, &ar, 0);
+  for (i = 0; i < N; ++i)
+    {
+      da_int_append (&ns, N / 2 - i);
+      isum += N / 2 - i;
+    }
+
+  FAILFALSE (da_int_sum (&ns) == isum, "invalid int sum.");
+  FAILFALSE (da_int_min (&ns) == N / 2 - (N - 1), "invalid int min.");
+  FAILFALSE (da_int_max (&ns) == N / 2, "invalid int max.");
+  FAILFALSE (da_int_count (&ns, CLOMY_CMPLT, 0) == N / 2, "invalid count.");
+  FAILFALSE (da_int_count (&ns, CLOMY_CMPLT | CLOMY_CMPEQ, 0) == N / 2 + 1,
+             "invalid count.");
+  FAILFALSE (da_int_count (&ns, CLOMY_CMPLT | CLOMY_CMPGT, 0) == N - 1,
+             "invalid count.");
+
+  printf ("Counting 100000 shorts...\n");
+  da_short_init (&ss, &ar, 0);
+  da_short_resize (&ss, 100000);
+  ss.data[99999] = 1;
+  FAILFALSE (da_short_count (&ss, CLOMY_CMPEQ, 0) == 99999,
+             "short count overflowed.");
+  FAILFALSE (da_short_max (&ss) == 1 && da_short_min (&ss) == 0,
+             "invalid short max.");
+
+  /* --------- Transforms --------- */
+  printf ("Scaling, adding and summing prefixes...\n");
+  da_double_scale (&ys, 0.5);
+  da_double_add (&xs, &ys);
+  FAILFALSE (da_double_sum (&xs) == sum + N, "invalid scale or add.");
+
+  da_int_prefix_sum (&ns);
+  FAILFALSE (ns.data[0] == N / 2 && ns.data[N - 1] == isum,
+             "invalid prefix sum.");
+
+  printf ("Wrapping around int overflow...\n");
+  da_int_resize (&ns, 0);
+  for (i = 0; i < 40; ++i)
+    da_int_append (&ns, 0x7fffffff);
+
+  FAILFALSE (da_int_sum (&ns) == -40, "int sum didn't wrap.");
+  da_int_scale (&ns, 2);
+  da_int_prefix_sum (&ns);
+  FAILFALSE (ns.data[0] == -2 && ns.data[39] == -80, "int scale didn't wrap.");
+
+  da_int_fold (&ns);
+  da_int_init (&ns, &ar, 0);
+  FAILFALSE (da_int_min (&ns) == 0 && da_int_sum (&ns) == 0,
+             "invalid empty array result.");
+
+  arfold (&ar);
+
+  printf ("Numeric kernels are working!\n");
+  return 0;
+}